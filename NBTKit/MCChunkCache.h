@@ -0,0 +1,54 @@
+//
+//  MCChunkCache.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @class MCChunkCache
+ *
+ * Cache of decoded chunks for MCRegion, with a limit on its size in bytes, evicting the least recently used chunks first.
+ *
+ * The cache keeps an immutable snapshot of each chunk's tree, and every read returns a new mutable copy of it,
+ * which can be modified freely: numbers and strings are shared with the snapshot, and arrays are copy-on-write.
+ * The size of a chunk is counted as the size of its uncompressed NBT.
+ * Chunks are removed from the cache when they are written or removed from their region, and when the region is rewritten.
+ *
+ * A cache can be shared by any number of regions, and used from any thread.
+ */
+@interface MCChunkCache : NSObject
+
+/**
+ * Initializes and returns a cache that holds chunks up to a given size of uncompressed NBT.
+ * @param byteLimit Maximum size of the cached chunks, in bytes.
+ */
+- (instancetype)initWithByteLimit:(NSUInteger)byteLimit NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Maximum size of the cached chunks, in bytes. Lowering it evicts chunks right away.
+@property (nonatomic) NSUInteger byteLimit;
+
+/// Size of the cached chunks, in bytes
+@property (nonatomic, readonly) NSUInteger byteCount;
+
+/// Number of cached chunks
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Number of chunks read from the cache
+@property (nonatomic, readonly) uint64_t hits;
+
+/// Number of chunks that had to be read from their region file
+@property (nonatomic, readonly) uint64_t misses;
+
+/// Removes all chunks from the cache, keeping the hit and miss counts
+- (void)removeAllChunks;
+
+@end
+
+NS_ASSUME_NONNULL_END
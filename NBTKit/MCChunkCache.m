@@ -0,0 +1,237 @@
+//
+//  MCChunkCache.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "MCChunkCache.h"
+#import "NBTKit_Private.h"
+#import "NBTCompound.h"
+#import <pthread.h>
+
+// region and chunk index
+#define MCChunkCacheKey(region, num) @((region) << 10 | (num))
+
+// copies the containers of a tree read from NBT, sharing its numbers and strings, and the data of its arrays until
+// they are modified. Snapshots have immutable containers.
+static id MCChunkCacheCopyTree(id tag, BOOL snapshot)
+{
+    switch (NBTTypeOfObject(tag)) {
+        case NBTTypeCompound: {
+            NBTCompound *compound = [[NBTCompound alloc] initWithCapacity:[tag count]];
+            for (NSString *key in tag) {
+                compound[key] = MCChunkCacheCopyTree(tag[key], snapshot);
+            }
+            return snapshot ? [compound copy] : compound;
+        }
+        case NBTTypeList: {
+            NSMutableArray *list = [NSMutableArray arrayWithCapacity:[tag count]];
+            for (id item in tag) {
+                [list addObject:MCChunkCacheCopyTree(item, snapshot)];
+            }
+            return snapshot ? [list copy] : list;
+        }
+        case NBTTypeByteArray:
+            return [tag mutableCopy];
+        case NBTTypeIntArray:
+        case NBTTypeLongArray:
+            return [tag copy];
+        default:
+            return tag;
+    }
+}
+
+// entries are owned by the dictionary, and linked from most to least recently used
+@interface MCChunkCacheEntry : NSObject
+{
+    @public
+    NSNumber *key;
+    id root;
+    NSUInteger cost;
+    __unsafe_unretained MCChunkCacheEntry *prev, *next;
+}
+@end
+
+@implementation MCChunkCacheEntry
+@end
+
+@implementation MCChunkCache
+{
+    pthread_mutex_t lock;
+    NSMutableDictionary<NSNumber*, MCChunkCacheEntry*> *entries;
+    __unsafe_unretained MCChunkCacheEntry *first, *last;
+    NSUInteger byteLimit, byteCount;
+    uint64_t hits, misses;
+}
+
+- (instancetype)initWithByteLimit:(NSUInteger)limit
+{
+    if ((self = [super init])) {
+        pthread_mutex_init(&lock, NULL);
+        entries = [NSMutableDictionary dictionary];
+        byteLimit = limit;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&lock);
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)byteLimit
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger value = byteLimit;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (void)setByteLimit:(NSUInteger)limit
+{
+    pthread_mutex_lock(&lock);
+    byteLimit = limit;
+    [self _evictToLimit:limit];
+    pthread_mutex_unlock(&lock);
+}
+
+- (NSUInteger)byteCount
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger value = byteCount;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (NSUInteger)count
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger value = entries.count;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (uint64_t)hits
+{
+    pthread_mutex_lock(&lock);
+    uint64_t value = hits;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (uint64_t)misses
+{
+    pthread_mutex_lock(&lock);
+    uint64_t value = misses;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (void)removeAllChunks
+{
+    pthread_mutex_lock(&lock);
+    [entries removeAllObjects];
+    first = last = nil;
+    byteCount = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+#pragma mark - LRU list, the lock must be held
+
+- (void)_unlinkEntry:(MCChunkCacheEntry*)entry
+{
+    if (entry->prev) entry->prev->next = entry->next; else first = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else last = entry->prev;
+    entry->prev = entry->next = nil;
+}
+
+- (void)_linkFirst:(MCChunkCacheEntry*)entry
+{
+    entry->next = first;
+    if (first) first->prev = entry; else last = entry;
+    first = entry;
+}
+
+- (void)_removeEntry:(MCChunkCacheEntry*)entry
+{
+    [self _unlinkEntry:entry];
+    byteCount -= entry->cost;
+    [entries removeObjectForKey:entry->key];
+}
+
+// removes least recently used chunks until byteCount is within limit
+- (void)_evictToLimit:(NSUInteger)limit
+{
+    while (byteCount > limit && last) {
+        MCChunkCacheEntry *entry = last;
+        [self _removeEntry:entry];
+    }
+}
+
+#pragma mark - Private
+
++ (id)_snapshotOfChunk:(id)root
+{
+    return MCChunkCacheCopyTree(root, YES);
+}
+
+- (id)_chunk:(NSUInteger)num ofRegion:(uint64_t)region
+{
+    pthread_mutex_lock(&lock);
+    MCChunkCacheEntry *entry = entries[MCChunkCacheKey(region, num)];
+    if (entry) {
+        hits++;
+        [self _unlinkEntry:entry];
+        [self _linkFirst:entry];
+    } else {
+        misses++;
+    }
+    id snapshot = entry ? entry->root : nil;
+    pthread_mutex_unlock(&lock);
+    return snapshot ? MCChunkCacheCopyTree(snapshot, NO) : nil;
+}
+
+- (void)_setSnapshot:(id)snapshot cost:(NSUInteger)cost forChunk:(NSUInteger)num ofRegion:(uint64_t)region
+{
+    NSNumber *key = MCChunkCacheKey(region, num);
+    pthread_mutex_lock(&lock);
+    MCChunkCacheEntry *entry = entries[key];
+    if (entry) [self _removeEntry:entry];
+    if (cost <= byteLimit) {
+        [self _evictToLimit:byteLimit - cost];
+        entry = [MCChunkCacheEntry new];
+        entry->key = key;
+        entry->root = snapshot;
+        entry->cost = cost;
+        entries[key] = entry;
+        [self _linkFirst:entry];
+        byteCount += cost;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+- (void)_removeChunk:(NSUInteger)num ofRegion:(uint64_t)region
+{
+    NSNumber *key = MCChunkCacheKey(region, num);
+    pthread_mutex_lock(&lock);
+    MCChunkCacheEntry *entry = entries[key];
+    if (entry) [self _removeEntry:entry];
+    pthread_mutex_unlock(&lock);
+}
+
+- (void)_removeChunksOfRegion:(uint64_t)region
+{
+    pthread_mutex_lock(&lock);
+    for (NSUInteger num=0; num < 1024 && entries.count; num++) {
+        NSNumber *key = MCChunkCacheKey(region, num);
+        MCChunkCacheEntry *entry = entries[key];
+        if (entry) [self _removeEntry:entry];
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+@end
@@ -8,10 +8,41 @@
 
 #import <Foundation/Foundation.h>
 
+@class MCChunkCache;
+
 NS_ASSUME_NONNULL_BEGIN
 
+/// Options for enumerating chunks in a region
+typedef NS_OPTIONS(NSUInteger, MCRegionEnumerationOptions) {
+    /// call the block from worker threads as chunks are decoded, in no particular order
+    MCRegionEnumerationConcurrent = 1 << 0,
+};
+
+/// Compression of the chunks in a region file
+typedef NS_ENUM(uint8_t, MCRegionCompression) {
+    MCRegionCompressionGzip = 1,
+    /// used by Minecraft by default
+    MCRegionCompressionZlib = 2,
+    MCRegionCompressionNone = 3,
+    /// faster to decompress than zlib, used by Minecraft 1.20.5 and later when configured
+    MCRegionCompressionLZ4 = 4,
+};
+
+/// Options for writing chunks to a region
+typedef NS_OPTIONS(NSUInteger, MCRegionWriteOptions) {
+    /// flush the file to disk after writing
+    MCRegionWriteSynchronize = 1 << 0,
+    /// update the timestamp of chunks that aren't written because they haven't changed
+    MCRegionWriteTouchUnchanged = 1 << 1,
+};
+
 /** @class MCRegion
  * Represents a region file (.mcr or .mca), and allows read/write access to its chunks.
+ *
+ * Chunks can be read from any number of threads at once, writes wait for reads in progress.
+ *
+ * The region keeps a hash of each chunk it has read or written, and setting a chunk to the same contents it already has
+ * doesn't write anything (or compress it). Changes made to the file by other means while it's open aren't noticed.
  */
 @interface MCRegion : NSObject
 
@@ -32,12 +63,27 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  * Rewrites all the chunks in the file, getting rid of fragmentation.
  *
+ * The chunks are copied to a temporary file next to the region file, which then replaces it, so the original file is left intact if writing fails.
  * This method raises an exception if no free space is left on the file system, or if any other writing error occurs.
  *
  * @return Number of bytes saved by rewriting
+ * @see rewriteInPlace:
  */
 - (NSInteger)rewrite;
 
+/**
+ * Rewrites all the chunks in the file, getting rid of fragmentation.
+ *
+ * Chunks are copied one at a time in the order they appear in the file, using a fixed size buffer.
+ * In place, chunks are moved towards the start of the file and the file is truncated; this doesn't need any extra disk space,
+ * but the region file may be left damaged if the process is interrupted.
+ * This method raises an exception if no free space is left on the file system, or if any other writing error occurs.
+ *
+ * @param inPlace YES to compact the file in place, NO to write a new file and replace the original.
+ * @return Number of bytes saved by rewriting
+ */
+- (NSInteger)rewriteInPlace:(BOOL)inPlace;
+
 /**
  * Gets a chunk from the region file, in coordinates relative to the region file (0-31)
  *
@@ -50,19 +96,83 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  * Writes a chunk to the region file, or removes it.
  *
- * If a chunk is too big (more than 1MB when compressed), it won't fit the region format, and return NO.
+ * Chunks that are too big for the region format (more than 1MB when compressed) are written to their own file next to the region file (c.X.Z.mcc), like Minecraft does.
+ * This needs the region coordinates from the file name (r.X.Z.mca), writing such chunks fails otherwise.
  * This method raises an exception if no free space is left on the file system, or if any other writing error occurs.
  *
  * @param root root tag of the chunk. Pass nil to remove the chunk from the file.
  * @param x X coordinate of the chunk (0-31)
  * @param z Z coordinate of the chunk (0-31)
- * @return YES on success, NO if the chunk is too big or the coordinates are invalid
+ * @return YES on success, NO if the chunk is invalid or the coordinates are invalid
  */
 - (BOOL)setChunk:(nullable NSDictionary*)root atX:(NSInteger)x Z:(NSInteger)z;
 
+/**
+ * Writes a chunk to the region file, or removes it.
+ *
+ * If the chunk has the same contents as the one in the file, it isn't written, and its timestamp is kept unless opts includes MCRegionWriteTouchUnchanged.
+ *
+ * @param root root tag of the chunk. Pass nil to remove the chunk from the file.
+ * @param x X coordinate of the chunk (0-31)
+ * @param z Z coordinate of the chunk (0-31)
+ * @param opts Write options.
+ * @return YES on success, NO if the chunk is invalid or the coordinates are invalid
+ * @see setChunk:atX:Z:
+ */
+- (BOOL)setChunk:(nullable NSDictionary*)root atX:(NSInteger)x Z:(NSInteger)z options:(MCRegionWriteOptions)opts;
+
+/**
+ * Writes or removes several chunks at once.
+ *
+ * The chunks are compressed in parallel and written together in contiguous sectors, without overwriting the data they replace,
+ * and the header is updated once after all of them have been written. Chunks that haven't changed are left as they are.
+ * If any chunk is invalid, nothing is written and this method returns NO.
+ * This method raises an exception if no free space is left on the file system, or if any other writing error occurs.
+ *
+ * @param chunks Dictionary of root tags keyed by chunk index (x + z*32). Use NSNull to remove a chunk from the file.
+ *               Indexes must be integers from 0 to 1023, and keys that give the same index are invalid.
+ * @param opts Write options.
+ * @return YES on success, NO if a chunk or an index is invalid
+ */
+- (BOOL)setChunks:(NSDictionary<NSNumber*, id>*)chunks options:(MCRegionWriteOptions)opts;
+
+/**
+ * Decodes all the chunks present in the region file in parallel.
+ *
+ * By default, the block is called on the calling thread in chunk index order (x + z*32).
+ * With MCRegionEnumerationConcurrent, it is called from worker threads as soon as each chunk is decoded, and must be thread safe.
+ * This method returns after all the calls to the block have finished. If reading a chunk raises an exception, the enumeration
+ * stops and the exception is raised on the calling thread.
+ *
+ * @param opts Enumeration options.
+ * @param block Block called for each chunk, with its root tag, coordinates and timestamp. Set *stop to YES to stop enumerating.
+ */
+- (void)enumerateChunksWithOptions:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop))block;
+
+/**
+ * Decodes some chunks of the region file in parallel.
+ *
+ * Chunks that aren't present in the file are skipped.
+ *
+ * @param indexes Indexes of the chunks to decode (x + z*32).
+ * @param opts Enumeration options.
+ * @param block Block called for each chunk, with its root tag, coordinates and timestamp. Set *stop to YES to stop enumerating.
+ * @see enumerateChunksWithOptions:usingBlock:
+ */
+- (void)enumerateChunksAtIndexes:(NSIndexSet*)indexes options:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop))block;
+
 /// YES if the region contains no chunks
 @property(nonatomic, readonly, getter=isEmpty) BOOL empty;
 
+/// Compression used for writing chunks, MCRegionCompressionZlib by default. Chunks are read with the compression they were written with.
+@property(nonatomic) MCRegionCompression compression;
+
+/// Read chunks with NBTInternStrings, sharing repeated keys, strings and small numbers between them
+@property(nonatomic) BOOL internStrings;
+
+/// Cache of decoded chunks, which can be shared with other regions, or nil to read every chunk from the file (the default)
+@property(nullable, strong) MCChunkCache *chunkCache;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,23 +7,79 @@
 //
 
 #import "NBTKit.h"
+#import "NBTKit_Private.h"
 #import "MCRegion.h"
+#import "NBTWriter.h"
+#import "NBTHash.h"
+#import <pthread.h>
+#import <sys/stat.h>
+
+#define MCRegionEnumerationBatchSize 64
+// big enough for the largest chunk (255 sectors)
+#define MCRegionCopyBufferSize (1024*1024)
+#define MCRegionSectorUsed(map, n) ((map)[(n) >> 6] & (1ULL << ((n) & 63)))
+// set in the compression type of chunks stored in their own file (c.X.Z.mcc)
+#define MCRegionExternalChunk 0x80
+
+// YES if a compressed chunk doesn't fit in 255 sectors, and is stored in an external file
+NS_INLINE BOOL MCRegionIsExternal(NSUInteger length) {
+    return (length + 5 + 4095) / 4096 > 255;
+}
+
+// sectors a compressed chunk takes in the region file, external chunks only have their header there
+NS_INLINE NSUInteger MCRegionChunkSectors(NSUInteger length) {
+    return MCRegionIsExternal(length) ? 1 : (length + 5 + 4095) / 4096;
+}
 
 @implementation MCRegion
 {
-    NSFileHandle *fileHandle;
+    NSString *path;
+    int fd;
+    // readers share the lock, writers hold it exclusively
+    pthread_rwlock_t lock;
+    // header tables, in host byte order
+    uint32_t locations[1024];
+    uint32_t timestamps[1024];
+    // one bit per sector, set if used by the header or a chunk
+    uint64_t *sectorMap;
+    NSUInteger sectorCount, sectorMapCapacity;
+    // hashes of the uncompressed chunks in the file as written or read, 0 if unknown
+    _Atomic(uint64_t) hashes[1024];
+    // type byte (compression and external flag) of the chunks as written or read, 0 if unknown
+    _Atomic(uint8_t) chunkTypes[1024];
+    // incremented when a chunk is written, so hashes of chunks read meanwhile aren't kept
+    uint32_t generations[1024];
+    // identifies the region's chunks in the cache
+    uint64_t cacheID;
+    // region coordinates from the file name, for external chunk files, which can't be used without them
+    NSInteger regionX, regionZ;
+    BOOL hasCoordinates;
 }
 
-- (instancetype)initWithFileAtPath:(NSString *)path
+@synthesize chunkCache = _chunkCache;
+
+- (instancetype)initWithFileAtPath:(NSString *)aPath
+{
+    return [self _initWithFileAtPath:aPath create:YES];
+}
+
+- (instancetype)_initWithFileAtPath:(NSString *)aPath create:(BOOL)create
 {
-    int fd = open(path.fileSystemRepresentation, O_CREAT | O_RDWR);
-    if (fd < 0) return nil;
-    NSFileHandle *fh = [[NSFileHandle alloc] initWithFileDescriptor:fd closeOnDealloc:YES];
-    // if the file exists, it must be a valid mcr
-    if (![self _checkHeader]) return nil;
-    
     if ((self = [super init])) {
-        fileHandle = fh;
+        path = aPath.copy;
+        fd = open(path.fileSystemRepresentation, create ? O_CREAT | O_RDWR : O_RDWR, 0644);
+        if (fd < 0) return nil;
+        pthread_rwlock_init(&lock, NULL);
+        static _Atomic(uint64_t) nextCacheID = 1;
+        cacheID = atomic_fetch_add_explicit(&nextCacheID, 1, memory_order_relaxed);
+        _compression = MCRegionCompressionZlib;
+        int rx = 0, rz = 0, length = 0;
+        const char *name = path.lastPathComponent.UTF8String;
+        hasCoordinates = sscanf(name, "r.%d.%d.%*3[a-z]%n", &rx, &rz, &length) == 2 && length > 0 && name[length] == '\0';
+        regionX = rx;
+        regionZ = rz;
+        // if the file exists, it must be a valid mcr
+        if (![self _loadHeader]) return nil;
     }
     return self;
 }
@@ -33,134 +89,696 @@
     return [[self alloc] initWithFileAtPath:path];
 }
 
-// returns root tag or nil
-- (id)_readChunk:(NSUInteger)num
+- (void)dealloc
 {
-    return [NBTKit NBTWithData:[self _readChunkData:num] name:NULL options:NBTCompressed error:NULL];
+    if (fd >= 0) {
+        close(fd);
+        pthread_rwlock_destroy(&lock);
+    }
+    free(sectorMap);
+    [_chunkCache _removeChunksOfRegion:cacheID];
 }
 
-- (NSDate*)_chunkTimestamp:(NSUInteger)num
+// the cache is only changed with the lock held for writing, so it doesn't change while writing
+- (MCChunkCache *)chunkCache
 {
-    // read chunk timestamp
-    [fileHandle seekToFileOffset:4096 + 4*num];
-    NSData *timestampData = [fileHandle readDataOfLength:4];
-    if (timestampData.length != 4) return nil;
-    return [NSDate dateWithTimeIntervalSince1970:OSReadBigInt32(timestampData.bytes, 0)];
+    pthread_rwlock_rdlock(&lock);
+    MCChunkCache *cache = _chunkCache;
+    pthread_rwlock_unlock(&lock);
+    return cache;
 }
 
-- (NSData*)_readChunkData:(NSUInteger)num
+- (void)setChunkCache:(MCChunkCache *)chunkCache
 {
-    @synchronized(self) {
-        // read chunk offset and size
-        [fileHandle seekToFileOffset:4*num];
-        NSData *loc = [fileHandle readDataOfLength:4];
-        if (loc.length != 4) return nil; // no header - is this a new file?
-        uint8_t *buf = (uint8_t*)loc.bytes;
-        int offset = (buf[0] << 16) | (buf[1] << 8) | buf[2];
-        int sectors = buf[3];
-        if (offset == 0 || sectors == 0) return nil; // chunk not present
-        
-        // read actual length and compression type
-        [fileHandle seekToFileOffset:offset * 4096];
-        NSData *chunkHeader = [fileHandle readDataOfLength:5];
-        int32_t chunkLength = OSReadBigInt32(chunkHeader.bytes, 0);
-        // compression can be ignored
-        NSData *chunkData = [fileHandle readDataOfLength:chunkLength-1];
-        return chunkData;
+    pthread_rwlock_wrlock(&lock);
+    if (chunkCache != _chunkCache) {
+        // chunks written from now on won't be removed from the old cache
+        [_chunkCache _removeChunksOfRegion:cacheID];
+        _chunkCache = chunkCache;
+    }
+    pthread_rwlock_unlock(&lock);
+}
+
+#pragma mark - File access
+
+- (void)_raiseFileError
+{
+    NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    @throw [NSException exceptionWithName:NSFileHandleOperationException reason:error.localizedDescription userInfo:@{@"error": error}];
+}
+
+- (unsigned long long)_fileSize
+{
+    struct stat st;
+    if (fstat(fd, &st)) [self _raiseFileError];
+    return st.st_size;
+}
+
+- (void)_truncateFileAtOffset:(unsigned long long)offset
+{
+    if (ftruncate(fd, offset)) [self _raiseFileError];
+}
+
+// reads up to len bytes at offset, returns the number of bytes read, shorter at the end of the file
+- (NSUInteger)_read:(void*)buf length:(NSUInteger)len atOffset:(unsigned long long)offset
+{
+    NBTStatisticsAdd(NBTStatisticRegionSeeks, 1);
+    NSUInteger total = 0;
+    while (total < len) {
+        ssize_t br = pread(fd, (uint8_t*)buf + total, len - total, offset + total);
+        if (br < 0 && errno == EINTR) continue;
+        if (br < 0) [self _raiseFileError];
+        if (br == 0) break;
+        total += br;
     }
+    return total;
 }
 
-- (BOOL)_checkHeader
+- (NSData*)_readLength:(NSUInteger)len atOffset:(unsigned long long)offset
 {
+    NSMutableData *data = [NSMutableData dataWithLength:len];
+    data.length = [self _read:data.mutableBytes length:len atOffset:offset];
+    return data;
+}
+
+- (void)_write:(const void*)buf length:(NSUInteger)len toFile:(int)file atOffset:(unsigned long long)offset
+{
+    NBTStatisticsAdd(NBTStatisticRegionSeeks, 1);
+    while (len > 0) {
+        ssize_t bw = pwrite(file, buf, len, offset);
+        if (bw < 0 && errno == EINTR) continue;
+        if (bw <= 0) [self _raiseFileError];
+        buf = (const uint8_t*)buf + bw;
+        len -= bw;
+        offset += bw;
+    }
+}
+
+- (void)_write:(const void*)buf length:(NSUInteger)len atOffset:(unsigned long long)offset
+{
+    [self _write:buf length:len toFile:fd atOffset:offset];
+}
+
+#pragma mark - Header and sector map
+
+// reads the header tables and builds the sector map, returns NO if the file isn't a valid region file
+- (BOOL)_loadHeader
+{
+    NBTStatisticsAdd(NBTStatisticRegionHeaderReads, 1);
+    memset(locations, 0, sizeof locations);
+    memset(timestamps, 0, sizeof timestamps);
+    
     // check header exists
-    [fileHandle seekToEndOfFile];
-    unsigned long long fileSize = fileHandle.offsetInFile;
+    unsigned long long fileSize = [self _fileSize];
+    [self _setSectorCount:0];
     if (fileSize == 0) return YES; // empty file is valid
     if (fileSize < 8192 || fileSize % 4096 != 0) return NO; // file must have 8K header, and be multiple of 4K (sector size)
     
     // read header
-    [fileHandle seekToFileOffset:0];
-    int maxSectors = 2;
-    NSData *header = [fileHandle readDataOfLength:4096];
+    NSData *header = [self _readLength:8192 atOffset:0];
+    if (header.length != 8192) return NO;
+    NSUInteger maxSectors = 2;
     for (NSUInteger i=0; i < 1024; i++) {
-        uint32_t loc = OSReadBigInt32(header.bytes, 4*i);
-        int offset = loc >> 8;
-        int sectors = loc & 0xFF;
-        maxSectors = MAX(maxSectors, offset+sectors);
+        locations[i] = OSReadBigInt32(header.bytes, 4*i);
+        timestamps[i] = OSReadBigInt32(header.bytes, 4096 + 4*i);
+        maxSectors = MAX(maxSectors, (locations[i] >> 8) + (locations[i] & 0xFF));
     }
     
     // check that file has all sectors
-    return maxSectors <= fileSize / 4096;
+    if (maxSectors > fileSize / 4096) return NO;
+    
+    [self _setSectorCount:fileSize / 4096];
+    [self _markSectors:NSMakeRange(0, 2) used:YES];
+    for (NSUInteger i=0; i < 1024; i++) {
+        [self _markSectors:[self _chunkRange:i] used:YES];
+    }
+    return YES;
+}
+
+- (NSRange)_chunkRange:(NSUInteger)num
+{
+    uint32_t loc = locations[num];
+    if ((loc >> 8) == 0 || (loc & 0xFF) == 0) return NSMakeRange(0, 0);
+    return NSMakeRange(loc >> 8, loc & 0xFF);
+}
+
+// resizes the sector map for a file of count sectors
+- (void)_setSectorCount:(NSUInteger)count
+{
+    NSUInteger words = (count + 63) / 64;
+    if (words > sectorMapCapacity) {
+        NSUInteger newCapacity = MAX(words, 2 * sectorMapCapacity);
+        sectorMap = reallocf(sectorMap, newCapacity * sizeof(uint64_t));
+        if (sectorMap == NULL) @throw [NSException exceptionWithName:NSMallocException reason:@"Can't allocate sector map" userInfo:nil];
+        memset(sectorMap + sectorMapCapacity, 0, (newCapacity - sectorMapCapacity) * sizeof(uint64_t));
+        sectorMapCapacity = newCapacity;
+    } else if (count < sectorCount) {
+        // clear sectors past the end
+        memset(sectorMap + words, 0, (sectorMapCapacity - words) * sizeof(uint64_t));
+        if (count % 64) sectorMap[count / 64] &= (1ULL << (count % 64)) - 1;
+    }
+    sectorCount = count;
 }
 
-- (BOOL)_writeChunk:(NSUInteger)num root:(NSDictionary*)root
+- (void)_markSectors:(NSRange)range used:(BOOL)used
 {
-    // compress data
-    NSData *chunkData = [NBTKit dataWithNBT:root name:NULL options:NBTCompressed+NBTUseZlib error:NULL];
-    NSUInteger chunkSectors = (chunkData.length+5+4095) / 4096;
-    if (chunkSectors > 255) return NO;
+    if (NSMaxRange(range) > sectorCount) [self _setSectorCount:NSMaxRange(range)];
+    for (NSUInteger n = range.location; n < NSMaxRange(range); n++) {
+        if (used) {
+            sectorMap[n >> 6] |= 1ULL << (n & 63);
+        } else {
+            sectorMap[n >> 6] &= ~(1ULL << (n & 63));
+        }
+    }
+}
+
+// updates NBTStatistics after writing, must be called with the lock held
+- (void)_addSectorStatisticsAllocated:(NSUInteger)allocated freed:(NSUInteger)freed
+{
+    if (!NBTStatisticsIsEnabled()) return;
+    NBTStatisticsAdd(NBTStatisticRegionSectorsAllocated, allocated);
+    NBTStatisticsAdd(NBTStatisticRegionSectorsFreed, freed);
+    NSUInteger used = 0;
+    for (NSUInteger i=0; i < (sectorCount + 63) / 64; i++) {
+        used += __builtin_popcountll(sectorMap[i]);
+    }
+    NBTStatisticsSet(NBTStatisticRegionSectors, sectorCount);
+    NBTStatisticsSet(NBTStatisticRegionFreeSectors, sectorCount - MIN(used, sectorCount));
+}
+
+// returns the first free run of count sectors, which may extend past the end of the file
+- (NSUInteger)_findFreeSectors:(NSUInteger)count
+{
+    NSUInteger n = 2, run = 0;
+    while (n < sectorCount) {
+        if ((n & 63) == 0 && sectorMap[n >> 6] == UINT64_MAX) {
+            // skip full words
+            n += 64;
+            run = 0;
+            continue;
+        }
+        if (MCRegionSectorUsed(sectorMap, n)) {
+            run = 0;
+        } else if (++run == count) {
+            return n + 1 - count;
+        }
+        n++;
+    }
+    return sectorCount - run;
+}
+
+#pragma mark - Reading
+
+// returns root tag or nil
+- (id)_readChunk:(NSUInteger)num
+{
+    NBTOptions opt = _internStrings ? NBTInternStrings : 0;
+    MCChunkCache *cache = self.chunkCache;
+    NSMutableDictionary *root = [cache _chunk:num ofRegion:cacheID];
+    if (root) return root;
     
-    @synchronized(self) {
-        if (root == nil || root.count == 0) return [self _writeChunkAllocation:num range:NSMakeRange(0, 0)];
+    // decompress separately to hash the chunk as it is in the file
+    uint32_t generation = 0;
+    uint8_t type = 0;
+    NSData *nbt = [self _readChunkData:num generation:&generation type:&type];
+    if (nbt == nil) return nil;
+    root = [NBTKit NBTWithData:nbt name:NULL options:opt error:NULL];
+    if (root) [self _didReadChunk:num data:nbt root:root type:type generation:generation cache:cache];
+    return root;
+}
+
+// remembers the hash and type of a chunk that was read and caches it, unless it has been written since
+- (void)_didReadChunk:(NSUInteger)num data:(NSData*)nbt root:(id)root type:(uint8_t)type generation:(uint32_t)generation cache:(MCChunkCache*)cache
+{
+    uint64_t hash = NBTHash(nbt.bytes, nbt.length) ?: 1;
+    id snapshot = cache ? [MCChunkCache _snapshotOfChunk:root] : nil;
+    pthread_rwlock_rdlock(&lock);
+    if (generations[num] == generation) {
+        atomic_store_explicit(&hashes[num], hash, memory_order_relaxed);
+        atomic_store_explicit(&chunkTypes[num], type, memory_order_relaxed);
+        if (cache == _chunkCache) [cache _setSnapshot:snapshot cost:nbt.length forChunk:num ofRegion:cacheID];
+    }
+    pthread_rwlock_unlock(&lock);
+}
+
+- (NSDate*)_chunkTimestamp:(NSUInteger)num
+{
+    pthread_rwlock_rdlock(&lock);
+    uint32_t timestamp = timestamps[num];
+    BOOL present = locations[num] != 0;
+    pthread_rwlock_unlock(&lock);
+    return present ? [NSDate dateWithTimeIntervalSince1970:timestamp] : nil;
+}
+
+- (NSData*)_readChunkData:(NSUInteger)num
+{
+    return [self _readChunkData:num generation:NULL type:NULL];
+}
+
+- (NSData*)_readChunkData:(NSUInteger)num generation:(uint32_t*)generation type:(uint8_t*)type
+{
+    // any number of readers can read at once, the data is decompressed after unlocking
+    uint8_t chunkType = 0;
+    NSData *chunkData = nil;
+    pthread_rwlock_rdlock(&lock);
+    @try {
+        if (generation) *generation = generations[num];
+        chunkData = [self _chunkData:num type:&chunkType];
+    }
+    @finally {
+        pthread_rwlock_unlock(&lock);
+    }
+    if (type) *type = chunkType;
+    return chunkData ? [self _decompressChunkData:chunkData compression:chunkType & ~MCRegionExternalChunk] : nil;
+}
+
+- (NSData*)_decompressChunkData:(NSData*)chunkData compression:(uint8_t)compression
+{
+    switch (compression) {
+        case MCRegionCompressionGzip:
+        case MCRegionCompressionZlib:
+            return [NBTKit _inflateData:chunkData error:NULL];
+        case MCRegionCompressionNone:
+            return chunkData;
+        case MCRegionCompressionLZ4:
+            return [NBTKit _decompressLZ4Data:chunkData error:NULL];
+        default:
+            return nil;
+    }
+}
+
+// path of the external file of a chunk, or nil if the region's coordinates are unknown
+- (NSString*)_externalChunkPath:(NSUInteger)num
+{
+    if (!hasCoordinates) return nil;
+    NSString *name = [NSString stringWithFormat:@"c.%ld.%ld.mcc", (long)(regionX * 32 + num % 32), (long)(regionZ * 32 + num / 32)];
+    return [path.stringByDeletingLastPathComponent stringByAppendingPathComponent:name];
+}
+
+// reads the compressed data of a chunk and its type byte, the lock must be held
+- (NSData*)_chunkData:(NSUInteger)num type:(uint8_t*)chunkType
+{
+    NSRange range = [self _chunkRange:num];
+    if (range.length == 0) return nil; // chunk not present
+    
+    // read all the chunk's sectors at once
+    NSData *sectors = [self _readLength:range.length * 4096 atOffset:range.location * 4096ULL];
+    if (sectors.length < 5) return nil;
+    
+    // actual length, and compression
+    uint32_t chunkLength = OSReadBigInt32(sectors.bytes, 0);
+    if (chunkLength < 1 || chunkLength - 1 > sectors.length - 5) return nil;
+    uint8_t type = ((const uint8_t*)sectors.bytes)[4];
+    *chunkType = type;
+    if (type & MCRegionExternalChunk) {
+        // too big for the region file
+        NSString *externalPath = [self _externalChunkPath:num];
+        return externalPath ? [NSData dataWithContentsOfFile:externalPath options:0 error:NULL] : nil;
+    }
+    return [sectors subdataWithRange:NSMakeRange(5, chunkLength - 1)];
+}
+
+#pragma mark - Writing
+
+// returns the uncompressed chunk and its hash, or nil if it's empty or invalid
+- (NSData*)_encodeChunk:(NSDictionary*)root hash:(uint64_t*)hash
+{
+    if (root == nil || root.count == 0) return nil;
+    NSMutableData *data = [NSMutableData dataWithCapacity:64*1024];
+    NBTWriter *writer = [[NBTWriter alloc] initWithData:data options:0];
+    writer.hashesPayload = YES;
+    if ([writer writeRootTag:root withName:nil error:NULL] == 0) return nil;
+    *hash = writer.payloadHash ?: 1; // 0 is unknown
+    return data;
+}
+
+// compresses a chunk with the region's compression, returns the compressed data and its compression type
+- (NSData*)_compressChunk:(NSData*)nbt compression:(uint8_t*)compression
+{
+    *compression = _compression;
+    switch (_compression) {
+        case MCRegionCompressionGzip:
+            return [NBTKit _deflateData:nbt options:0 error:NULL];
+        case MCRegionCompressionNone:
+            return nbt;
+        case MCRegionCompressionLZ4:
+            return [NBTKit _compressLZ4Data:nbt];
+        case MCRegionCompressionZlib:
+        default:
+            *compression = MCRegionCompressionZlib;
+            return [NBTKit _deflateData:nbt options:NBTUseZlib error:NULL];
+    }
+}
+
+// YES if the compressed chunk can be stored, chunks too big for the region file need its coordinates
+- (BOOL)_canStoreChunkData:(NSData*)chunkData
+{
+    return !MCRegionIsExternal(chunkData.length) || hasCoordinates;
+}
+
+// fills in the header of a compressed chunk, writing it to a temporary file if it's too big, returns YES if it is
+- (BOOL)_prepareChunk:(NSUInteger)num data:(NSData*)chunkData compression:(uint8_t)compression header:(uint8_t*)header tempPath:(NSString**)tempPath
+{
+    BOOL external = MCRegionIsExternal(chunkData.length);
+    if (external) {
+        // it replaces the external file after the header is written
+        char tmpPath[PATH_MAX];
+        struct stat st;
+        snprintf(tmpPath, sizeof tmpPath, "%s.XXXXXX", [self _externalChunkPath:num].fileSystemRepresentation);
+        int chunkFd = -1;
+        if (fstat(fd, &st) || (chunkFd = mkstemp(tmpPath)) < 0) [self _raiseFileError];
+        fchmod(chunkFd, st.st_mode & 07777);
+        @try {
+            [self _write:chunkData.bytes length:chunkData.length toFile:chunkFd atOffset:0];
+        }
+        @catch (NSException *exception) {
+            unlink(tmpPath);
+            @throw;
+        }
+        @finally {
+            close(chunkFd);
+        }
+        *tempPath = @(tmpPath);
+    }
+    OSWriteBigInt32(header, 0, external ? 1 : (uint32_t)chunkData.length + 1);
+    header[4] = compression | (external ? MCRegionExternalChunk : 0);
+    return external;
+}
+
+// moves a prepared external chunk to its file, after committing the header
+- (void)_commitExternalChunk:(NSUInteger)num tempPath:(NSString*)tempPath
+{
+    if (rename(tempPath.fileSystemRepresentation, [self _externalChunkPath:num].fileSystemRepresentation)) [self _raiseFileError];
+}
+
+- (void)_removeExternalChunk:(NSUInteger)num
+{
+    NSString *externalPath = [self _externalChunkPath:num];
+    if (externalPath) unlink(externalPath.fileSystemRepresentation);
+}
+
+// YES if the chunk in the file is stored in an external file, reading its type only if it isn't known, the lock must be held
+- (BOOL)_isChunkExternal:(NSUInteger)num
+{
+    NSRange range = [self _chunkRange:num];
+    if (range.length != 1) return NO;
+    uint8_t type = atomic_load_explicit(&chunkTypes[num], memory_order_relaxed);
+    if (type == 0) {
+        uint8_t header[5];
+        if ([self _read:header length:5 atOffset:range.location * 4096ULL] < 5) return NO;
+        type = header[4];
+        atomic_store_explicit(&chunkTypes[num], type, memory_order_relaxed);
+    }
+    return (type & MCRegionExternalChunk) != 0;
+}
+
+// YES if the chunk was last written or read with the same hash and the current compression, without locking
+- (BOOL)_chunk:(NSUInteger)num matchesHash:(uint64_t)hash
+{
+    uint8_t type = atomic_load_explicit(&chunkTypes[num], memory_order_relaxed);
+    return atomic_load_explicit(&hashes[num], memory_order_relaxed) == hash && (type & ~MCRegionExternalChunk) == _compression;
+}
+
+// YES if the chunk in the file has the same hash and compression, the lock must be held
+- (BOOL)_isChunk:(NSUInteger)num unchangedWithHash:(uint64_t)hash
+{
+    return locations[num] != 0 && [self _chunk:num matchesHash:hash];
+}
+
+// records the hash and type of a chunk that was written or removed, and drops it from the cache, the lock must be held for writing
+- (void)_didWriteChunk:(NSUInteger)num hash:(uint64_t)hash type:(uint8_t)type
+{
+    atomic_store_explicit(&hashes[num], hash, memory_order_relaxed);
+    atomic_store_explicit(&chunkTypes[num], type, memory_order_relaxed);
+    generations[num]++;
+    [_chunkCache _removeChunk:num ofRegion:cacheID];
+}
+
+- (BOOL)_writeChunk:(NSUInteger)num root:(NSDictionary*)root options:(MCRegionWriteOptions)opts
+{
+    // encode, and compress unless it looks unchanged
+    uint64_t hash = 0;
+    NSData *nbt = [self _encodeChunk:root hash:&hash];
+    if (root.count && nbt == nil) return NO;
+    BOOL unchanged = nbt && [self _chunk:num matchesHash:hash];
+    uint8_t compression = 0;
+    NSData *chunkData = nbt && !unchanged ? [self _compressChunk:nbt compression:&compression] : nil;
+    
+    NSString *tempPath = nil;
+    pthread_rwlock_wrlock(&lock);
+    @try {
+        NSRange oldRange = [self _chunkRange:num];
+        if (nbt == nil) {
+            if (oldRange.length == 0) return YES;
+            BOOL wasExternal = [self _isChunkExternal:num];
+            [self _writeChunkAllocation:num range:NSMakeRange(0, 0)];
+            [self _markSectors:oldRange used:NO];
+            [self _addSectorStatisticsAllocated:0 freed:oldRange.length];
+            [self _didWriteChunk:num hash:0 type:0];
+            if (wasExternal) [self _removeExternalChunk:num];
+            return YES;
+        }
+        if (unchanged) {
+            if ([self _isChunk:num unchangedWithHash:hash]) {
+                if (opts & MCRegionWriteTouchUnchanged) [self _writeChunkAllocation:num range:oldRange];
+                return YES;
+            }
+            // written by another thread since
+            chunkData = [self _compressChunk:nbt compression:&compression];
+        }
+        if (chunkData == nil || ![self _canStoreChunkData:chunkData]) return NO;
+        NSUInteger chunkSectors = MCRegionChunkSectors(chunkData.length);
+        BOOL wasExternal = [self _isChunkExternal:num];
         
         // ensure there's a MCR header
-        [fileHandle seekToEndOfFile];
-        if (fileHandle.offsetInFile < 8192) [fileHandle truncateFileAtOffset:8192];
-        
-        // read sector allocation map
-        NSMutableData *allocationMap = [NSMutableData dataWithLength:fileHandle.offsetInFile/4096];
-        uint8_t *map = (uint8_t*)allocationMap.bytes;
-        memcpy(map, "xx", 2); // mark blocks occupied by header
-        [fileHandle seekToFileOffset:0];
-        NSData *header = [fileHandle readDataOfLength:4096];
-        for (NSUInteger i=0; i < 1024; i++) {
-            if (i == num) continue; // don't read allocation for this chunk
-            uint32_t loc = OSReadBigInt32(header.bytes, 4*i);
-            int offset = loc >> 8;
-            int sectors = loc & 0xFF;
-            // mark used blocks
-            for (int b=0; b < sectors; b++) map[offset+b] = 'x';
+        if (sectorCount < 2) {
+            [self _truncateFileAtOffset:8192];
+            [self _markSectors:NSMakeRange(0, 2) used:YES];
         }
         
-        // add empty space at end for this chunk, in case it's needed
-        allocationMap.length += chunkSectors;
-        
-        // find empty space
-        NSRange chunkRange = [allocationMap rangeOfData:[NSMutableData dataWithLength:chunkSectors] options:0 range:NSMakeRange(0, allocationMap.length)];
-        if (chunkRange.location == NSNotFound) return NO; // this shouldn't happen
+        // find empty space, the chunk may reuse its own sectors
+        [self _markSectors:oldRange used:NO];
+        NSRange chunkRange = NSMakeRange([self _findFreeSectors:chunkSectors], chunkSectors);
+        [self _markSectors:oldRange used:YES];
         
         // write chunk
         uint8_t chunkHeader[5];
-        OSWriteBigInt32(chunkHeader, 0, chunkData.length+1);
-        chunkHeader[4] = 2; // zlib compression
-        [fileHandle seekToFileOffset:4096 * chunkRange.location];
-        [fileHandle writeData:[NSData dataWithBytesNoCopy:chunkHeader length:5 freeWhenDone:NO]];
-        [fileHandle writeData:chunkData];
+        BOOL external = [self _prepareChunk:num data:chunkData compression:compression header:chunkHeader tempPath:&tempPath];
+        [self _write:chunkHeader length:5 atOffset:4096ULL * chunkRange.location];
+        if (!external) [self _write:chunkData.bytes length:chunkData.length atOffset:4096ULL * chunkRange.location + 5];
         
         // padding if needed
-        [fileHandle seekToEndOfFile];
-        if (fileHandle.offsetInFile % 4096 != 0) {
-            [fileHandle truncateFileAtOffset:(fileHandle.offsetInFile + 4095) &~ 4095ULL];
+        if (NSMaxRange(chunkRange) > sectorCount) {
+            [self _truncateFileAtOffset:4096ULL * NSMaxRange(chunkRange)];
         }
         
-        return [self _writeChunkAllocation:num range:chunkRange];
+        [self _writeChunkAllocation:num range:chunkRange];
+        [self _markSectors:oldRange used:NO];
+        [self _markSectors:chunkRange used:YES];
+        [self _addSectorStatisticsAllocated:chunkRange.length freed:oldRange.length];
+        [self _didWriteChunk:num hash:hash type:chunkHeader[4]];
+        if (external) {
+            [self _commitExternalChunk:num tempPath:tempPath];
+            tempPath = nil;
+        } else if (wasExternal) {
+            [self _removeExternalChunk:num];
+        }
+        if (opts & MCRegionWriteSynchronize) fsync(fd);
+        return YES;
+    }
+    @catch (NSException *exception) {
+        if (tempPath) unlink(tempPath.fileSystemRepresentation);
+        @throw;
+    }
+    @finally {
+        pthread_rwlock_unlock(&lock);
     }
 }
 
-- (BOOL)_writeChunkAllocation:(NSUInteger)num range:(NSRange)chunkRange
+// writes the header entries for a chunk
+- (void)_writeChunkAllocation:(NSUInteger)num range:(NSRange)chunkRange
 {
-    // write allocation in header
     uint8_t buf[4];
-    OSWriteBigInt32(buf, 0, chunkRange.location << 8 | chunkRange.length);
-    [fileHandle seekToFileOffset:4*num];
-    [fileHandle writeData:[NSData dataWithBytes:buf length:4]];
+    uint32_t location = (uint32_t)(chunkRange.location << 8 | chunkRange.length);
+    uint32_t timestamp = chunkRange.length ? (uint32_t)time(NULL) : 0;
+    
+    // write allocation in header
+    if (location != locations[num]) {
+        OSWriteBigInt32(buf, 0, location);
+        [self _write:buf length:4 atOffset:4*num];
+        locations[num] = location;
+    }
     
     // write timestamp
-    OSWriteBigInt32(buf, 0, chunkRange.length ? time(NULL) : 0);
-    [fileHandle seekToFileOffset:4096 + 4*num];
-    [fileHandle writeData:[NSData dataWithBytes:buf length:4]];
+    if (timestamp != timestamps[num]) {
+        OSWriteBigInt32(buf, 0, timestamp);
+        [self _write:buf length:4 atOffset:4096 + 4*num];
+        timestamps[num] = timestamp;
+    }
+}
+
+// writes both header tables
+- (void)_writeHeaderLocations:(const uint32_t*)newLocations timestamps:(const uint32_t*)newTimestamps toFile:(int)file
+{
+    uint32_t header[2048];
+    for (NSUInteger i=0; i < 1024; i++) {
+        OSWriteBigInt32(header, 4*i, newLocations[i]);
+        OSWriteBigInt32(header, 4096 + 4*i, newTimestamps[i]);
+    }
+    [self _write:header length:sizeof header toFile:file atOffset:0];
+}
+
+- (BOOL)_writeChunks:(const NSUInteger*)nums roots:(NSArray*)roots count:(NSUInteger)count options:(MCRegionWriteOptions)opts
+{
+    // encode and compress in parallel, keeping the uncompressed data of chunks that look unchanged
+    uint64_t *chunkHashes = calloc(count, sizeof(uint64_t));
+    uint8_t *compressions = calloc(count, sizeof(uint8_t));
+    void **encoded = calloc(count, sizeof(void*));
+    void **compressed = calloc(count, sizeof(void*));
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        id root = roots[i];
+        NSData *nbt = [self _encodeChunk:root == [NSNull null] ? nil : root hash:&chunkHashes[i]];
+        if (nbt == nil) return;
+        if ([self _chunk:nums[i] matchesHash:chunkHashes[i]]) {
+            encoded[i] = (void*)CFBridgingRetain(nbt);
+        } else {
+            compressed[i] = (void*)CFBridgingRetain([self _compressChunk:nbt compression:&compressions[i]]);
+        }
+    });
+    NSMutableArray *nbts = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray *chunks = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i=0; i < count; i++) {
+        [nbts addObject:CFBridgingRelease(encoded[i]) ?: [NSNull null]];
+        [chunks addObject:CFBridgingRelease(compressed[i]) ?: [NSNull null]];
+    }
+    free(encoded);
+    free(compressed);
+    uint64_t newHashes[count];
+    uint8_t types[count];
+    memcpy(newHashes, chunkHashes, sizeof newHashes);
+    memcpy(types, compressions, sizeof types);
+    free(chunkHashes);
+    free(compressions);
     
-    return YES;
+    // check sizes
+    NSUInteger sectors[count];
+    for (NSUInteger i=0; i < count; i++) {
+        NSData *chunkData = chunks[i];
+        id root = roots[i];
+        if (chunkData == (id)[NSNull null]) {
+            if (nbts[i] == [NSNull null] && root != [NSNull null] && [root count]) return NO; // encoding or compression failed
+            sectors[i] = 0;
+        } else if ([self _canStoreChunkData:chunkData]) {
+            sectors[i] = MCRegionChunkSectors(chunkData.length);
+        } else {
+            return NO;
+        }
+    }
+    
+    NSMutableDictionary<NSNumber*, NSString*> *tempPaths = [NSMutableDictionary dictionary];
+    pthread_rwlock_wrlock(&lock);
+    @try {
+        // skip unchanged chunks, and compress the ones that were written by another thread since
+        BOOL skipped[count], external[count], wasExternal[count];
+        NSUInteger totalSectors = 0, skippedCount = 0;
+        for (NSUInteger i=0; i < count; i++) {
+            skipped[i] = external[i] = wasExternal[i] = NO;
+            if (nbts[i] == [NSNull null]) {
+                totalSectors += sectors[i];
+                continue;
+            }
+            if ([self _isChunk:nums[i] unchangedWithHash:newHashes[i]]) {
+                skipped[i] = YES;
+                skippedCount++;
+                continue;
+            }
+            NSData *chunkData = [self _compressChunk:nbts[i] compression:&types[i]];
+            if (chunkData == nil || ![self _canStoreChunkData:chunkData]) return NO;
+            sectors[i] = MCRegionChunkSectors(chunkData.length);
+            chunks[i] = chunkData;
+            totalSectors += sectors[i];
+        }
+        if (skippedCount == count && !(opts & MCRegionWriteTouchUnchanged)) return YES;
+        
+        // ensure there's a MCR header
+        if (sectorCount < 2) {
+            [self _truncateFileAtOffset:8192];
+            [self _markSectors:NSMakeRange(0, 2) used:YES];
+        }
+        
+        // allocate the whole batch together, without reusing the sectors it replaces
+        NSUInteger firstSector = [self _findFreeSectors:totalSectors];
+        NSMutableData *payload = [NSMutableData dataWithLength:4096 * totalSectors];
+        uint8_t *buf = payload.mutableBytes;
+        for (NSUInteger i=0; i < count; i++) {
+            if (skipped[i]) continue;
+            wasExternal[i] = [self _isChunkExternal:nums[i]];
+            if (sectors[i] == 0) continue;
+            NSData *chunkData = chunks[i];
+            NSString *tempPath = nil;
+            external[i] = [self _prepareChunk:nums[i] data:chunkData compression:types[i] header:buf tempPath:&tempPath];
+            if (tempPath) tempPaths[@(i)] = tempPath;
+            types[i] = buf[4];
+            if (!external[i]) memcpy(buf + 5, chunkData.bytes, chunkData.length);
+            buf += 4096 * sectors[i];
+        }
+        [self _write:payload.bytes length:payload.length atOffset:4096ULL * firstSector];
+        
+        // commit header, the tables in memory are only updated if it's written
+        uint32_t now = (uint32_t)time(NULL);
+        uint32_t newLocations[1024], newTimestamps[1024];
+        memcpy(newLocations, locations, sizeof newLocations);
+        memcpy(newTimestamps, timestamps, sizeof newTimestamps);
+        NSUInteger curSector = firstSector;
+        NSRange freed[count];
+        for (NSUInteger i=0; i < count; i++) {
+            if (skipped[i]) {
+                freed[i] = NSMakeRange(0, 0);
+                if (opts & MCRegionWriteTouchUnchanged) newTimestamps[nums[i]] = now;
+                continue;
+            }
+            freed[i] = [self _chunkRange:nums[i]];
+            newLocations[nums[i]] = sectors[i] ? (uint32_t)(curSector << 8 | sectors[i]) : 0;
+            newTimestamps[nums[i]] = sectors[i] ? now : 0;
+            curSector += sectors[i];
+        }
+        [self _writeHeaderLocations:newLocations timestamps:newTimestamps toFile:fd];
+        memcpy(locations, newLocations, sizeof newLocations);
+        memcpy(timestamps, newTimestamps, sizeof newTimestamps);
+        if (opts & MCRegionWriteSynchronize) fsync(fd);
+        
+        // update sector map and hashes
+        NSUInteger freedSectors = 0;
+        for (NSUInteger i=0; i < count; i++) {
+            [self _markSectors:freed[i] used:NO];
+            freedSectors += freed[i].length;
+        }
+        for (NSUInteger i=0; i < count; i++) {
+            [self _markSectors:[self _chunkRange:nums[i]] used:YES];
+            if (!skipped[i]) [self _didWriteChunk:nums[i] hash:newHashes[i] type:types[i]];
+        }
+        [self _addSectorStatisticsAllocated:totalSectors freed:freedSectors];
+        
+        // replace external files after the header points at the new chunks
+        for (NSUInteger i=0; i < count; i++) {
+            if (external[i]) {
+                [self _commitExternalChunk:nums[i] tempPath:tempPaths[@(i)]];
+                [tempPaths removeObjectForKey:@(i)];
+            } else if (wasExternal[i]) {
+                [self _removeExternalChunk:nums[i]];
+            }
+        }
+        return YES;
+    }
+    @catch (NSException *exception) {
+        for (NSString *tempPath in tempPaths.objectEnumerator) {
+            unlink(tempPath.fileSystemRepresentation);
+        }
+        @throw;
+    }
+    @finally {
+        pthread_rwlock_unlock(&lock);
+    }
 }
 
 - (NSMutableDictionary*)getChunkAtX:(NSInteger)x Z:(NSInteger)z
@@ -170,68 +788,227 @@
 }
 
 - (BOOL)setChunk:(NSDictionary*)root atX:(NSInteger)x Z:(NSInteger)z
+{
+    return [self setChunk:root atX:x Z:z options:0];
+}
+
+- (BOOL)setChunk:(NSDictionary *)root atX:(NSInteger)x Z:(NSInteger)z options:(MCRegionWriteOptions)opts
 {
     if (x < 0 || z < 0 || x > 31 || z > 31) return NO;
-    if (root && ![NBTKit isValidNBTObject:root]) return NO;
-    return [self _writeChunk:x + z*32 root:root];
+    return [self _writeChunk:x + z*32 root:root options:opts];
+}
+
+- (BOOL)setChunks:(NSDictionary<NSNumber*,id> *)chunks options:(MCRegionWriteOptions)opts
+{
+    if (chunks.count > 1024) return NO;
+    NSUInteger count = 0;
+    NSUInteger nums[1024];
+    BOOL seen[1024] = {NO};
+    NSMutableArray *roots = [NSMutableArray arrayWithCapacity:chunks.count];
+    for (NSNumber *key in [chunks.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        if (![key isKindOfClass:[NSNumber class]]) return NO;
+        NSInteger num = key.integerValue;
+        id root = chunks[key];
+        // each chunk once, by an integral index
+        if (num < 0 || num > 1023 || key.doubleValue != (double)num || seen[num]) return NO;
+        seen[num] = YES;
+        // the contents are checked when writing
+        if (root != [NSNull null] && ![root isKindOfClass:[NSDictionary class]]) return NO;
+        nums[count++] = num;
+        [roots addObject:root];
+    }
+    if (count == 0) return YES;
+    return [self _writeChunks:nums roots:roots count:count options:opts];
+}
+
+- (void)enumerateChunksWithOptions:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *, NSInteger, NSInteger, NSDate *, BOOL *))block
+{
+    [self enumerateChunksAtIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 1024)] options:opts usingBlock:block];
+}
+
+- (void)enumerateChunksAtIndexes:(NSIndexSet *)indexes options:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *, NSInteger, NSInteger, NSDate *, BOOL *))block
+{
+    // present chunks
+    NSUInteger count = 0;
+    NSUInteger present[1024];
+    pthread_rwlock_rdlock(&lock);
+    for (NSUInteger i = indexes.firstIndex; i < 1024; i = [indexes indexGreaterThanIndex:i]) {
+        if (locations[i]) present[count++] = i;
+    }
+    pthread_rwlock_unlock(&lock);
+    const NSUInteger *chunkIndexes = present;
+    
+    // exceptions can't leave the worker threads, they're kept by chunk and raised on this thread
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    void *chunkExceptions[1024] = {NULL};
+    void **exceptions = chunkExceptions;
+    if (opts & MCRegionEnumerationConcurrent) {
+        __block volatile BOOL stop = NO;
+        dispatch_apply(count, queue, ^(size_t i) {
+            if (stop) return;
+            @autoreleasepool {
+                @try {
+                    NSUInteger num = chunkIndexes[i];
+                    NSMutableDictionary *root = [self _readChunk:num];
+                    NSDate *timestamp = [self _chunkTimestamp:num];
+                    if (root == nil || timestamp == nil || stop) return;
+                    BOOL blockStop = NO;
+                    block(root, num % 32, num / 32, timestamp, &blockStop);
+                    if (blockStop) stop = YES;
+                }
+                @catch (NSException *exception) {
+                    exceptions[i] = (void*)CFBridgingRetain(exception);
+                    stop = YES;
+                }
+            }
+        });
+        [self _raiseFirstException:exceptions count:count];
+        return;
+    }
+    
+    // decode in batches, deliver in order up to the first chunk that couldn't be read
+    BOOL stop = NO;
+    void *batchRoots[MCRegionEnumerationBatchSize];
+    void **roots = batchRoots;
+    for (NSUInteger start=0; start < count && !stop; start += MCRegionEnumerationBatchSize) {
+        NSUInteger batch = MIN(count - start, MCRegionEnumerationBatchSize);
+        const NSUInteger *batchIndexes = chunkIndexes + start;
+        dispatch_apply(batch, queue, ^(size_t i) {
+            @autoreleasepool {
+                @try {
+                    roots[i] = (void*)CFBridgingRetain([self _readChunk:batchIndexes[i]]);
+                }
+                @catch (NSException *exception) {
+                    roots[i] = NULL;
+                    exceptions[i] = (void*)CFBridgingRetain(exception);
+                }
+            }
+        });
+        for (NSUInteger i=0; i < batch; i++) {
+            NSMutableDictionary *root = CFBridgingRelease(roots[i]);
+            if (exceptions[i]) {
+                for (NSUInteger j=i+1; j < batch; j++) CFBridgingRelease(roots[j]);
+                [self _raiseFirstException:exceptions + i count:batch - i];
+            }
+            NSDate *timestamp = [self _chunkTimestamp:batchIndexes[i]];
+            if (root == nil || timestamp == nil || stop) continue;
+            block(root, batchIndexes[i] % 32, batchIndexes[i] / 32, timestamp, &stop);
+        }
+    }
+}
+
+// raises the first of the exceptions caught by workers, releasing the rest
+- (void)_raiseFirstException:(void**)exceptions count:(NSUInteger)count
+{
+    NSException *first = nil;
+    for (NSUInteger i=0; i < count; i++) {
+        NSException *exception = CFBridgingRelease(exceptions[i]);
+        if (first == nil) first = exception;
+    }
+    if (first) @throw first;
 }
 
 - (NSInteger)rewrite
+{
+    return [self rewriteInPlace:NO];
+}
+
+- (NSInteger)rewriteInPlace:(BOOL)inPlace
 {
     NSInteger savedSize = 0;
-    @synchronized(self) {
-        // get current size
-        [fileHandle seekToEndOfFile];
-        unsigned long long oldSize = fileHandle.offsetInFile;
+    uint8_t *buf = malloc(MCRegionCopyBufferSize);
+    pthread_rwlock_wrlock(&lock);
+    @try {
+        if (sectorCount == 0) return 0;
+        unsigned long long oldSize = [self _fileSize];
         
-        // read all chunks and check sizes
-        NSMutableDictionary *chunks = [NSMutableDictionary dictionaryWithCapacity:1024];
-        NSMutableDictionary *timestamps = [NSMutableDictionary dictionaryWithCapacity:1024];
+        // present chunks in sector order
+        NSUInteger count = 0;
+        NSUInteger order[1024];
         for (NSUInteger i=0; i < 1024; i++) {
-            NSData *chunkData = [self _readChunkData:i];
-            if (chunkData) {
-                chunks[@(i)] = chunkData;
-                timestamps[@(i)] = [self _chunkTimestamp:i];
-            }
+            if ([self _chunkRange:i].length) order[count++] = i;
         }
+        qsort_b(order, count, sizeof *order, ^int(const void *a, const void *b) {
+            uint32_t la = self->locations[*(const NSUInteger*)a], lb = self->locations[*(const NSUInteger*)b];
+            return la < lb ? -1 : la > lb;
+        });
         
-        // write the whole file
-        [fileHandle truncateFileAtOffset:0];
-        
-        // header
-        NSMutableData *header = [NSMutableData dataWithLength:8192];
+        // copy chunks towards the start of the file, or to a new file next to it
+        // (next to the file a symlink points to, so the link itself is kept)
+        char targetPath[PATH_MAX], tmpPath[PATH_MAX];
+        int dstFd = fd;
+        if (!inPlace) {
+            struct stat st;
+            if (realpath(path.fileSystemRepresentation, targetPath) == NULL) [self _raiseFileError];
+            snprintf(tmpPath, sizeof tmpPath, "%s.XXXXXX", targetPath);
+            if (fstat(fd, &st) || (dstFd = mkstemp(tmpPath)) < 0) [self _raiseFileError];
+            fchmod(dstFd, st.st_mode & 07777);
+        }
         
-        // write chunks
-        NSUInteger curSector = 2;
-        [fileHandle seekToFileOffset:8192];
-        for (NSUInteger i=0; i < 1024; i++) {
-            NSData *chunkData = chunks[@(i)];
-            if (chunkData == nil) continue; // missing chunk
-            
-            // set header
-            NSUInteger chunkSectors = (chunkData.length+5+4095) / 4096;
-            OSWriteBigInt32(header.mutableBytes, 4*i, curSector << 8 | chunkSectors);
-            OSWriteBigInt32(header.mutableBytes+4096, 4*i, (int32_t)[timestamps[@(i)] timeIntervalSince1970]);
-            curSector += chunkSectors;
+        @try {
+            uint32_t newLocations[1024] = {0};
+            NSUInteger curSector = 2;
+            for (NSUInteger i=0; i < count; i++) {
+                NSUInteger num = order[i];
+                NSRange range = [self _chunkRange:num];
+                NSUInteger len = [self _read:buf length:range.length * 4096 atOffset:range.location * 4096ULL];
+                if (len < 5) continue;
+                uint32_t chunkLength = OSReadBigInt32(buf, 0);
+                if (chunkLength < 1 || chunkLength - 1 > len - 5) continue; // invalid chunk
+                NSUInteger chunkSectors = (chunkLength + 4 + 4095) / 4096;
+                
+                [self _write:buf length:chunkLength + 4 toFile:dstFd atOffset:4096ULL * curSector];
+                newLocations[num] = (uint32_t)(curSector << 8 | chunkSectors);
+                if (inPlace && newLocations[num] != locations[num]) {
+                    // point the header at the moved chunk before overwriting anything else
+                    uint8_t loc[4];
+                    OSWriteBigInt32(loc, 0, newLocations[num]);
+                    [self _write:loc length:4 atOffset:4*num];
+                }
+                curSector += chunkSectors;
+            }
             
-            // write chunk
-            uint8_t chunkHeader[5];
-            OSWriteBigInt32(chunkHeader, 0, chunkData.length+1);
-            chunkHeader[4] = 2; // zlib compression
-            [fileHandle writeData:[NSData dataWithBytesNoCopy:chunkHeader length:5 freeWhenDone:NO]];
-            [fileHandle writeData:chunkData];
+            // header and end of file
+            memcpy(locations, newLocations, sizeof locations);
+            for (NSUInteger i=0; i < 1024; i++) {
+                if (locations[i] == 0) timestamps[i] = 0;
+            }
+            [self _writeHeaderLocations:locations timestamps:timestamps toFile:dstFd];
+            if (ftruncate(dstFd, 4096ULL * curSector) || fsync(dstFd)) [self _raiseFileError];
+            savedSize = oldSize - 4096ULL * curSector;
             
-            // zero fill
-            [fileHandle truncateFileAtOffset:(fileHandle.offsetInFile + 4095) &~ 4095ULL];
+            // swap in the new file
+            if (!inPlace) {
+                if (rename(tmpPath, targetPath)) [self _raiseFileError];
+                close(fd);
+                fd = dstFd;
+                
+                // make the rename durable
+                char *slash = strrchr(targetPath, '/');
+                if (slash) *slash = '\0';
+                int dirFd = open(slash ? (slash == targetPath ? "/" : targetPath) : ".", O_RDONLY);
+                if (dirFd >= 0) {
+                    fsync(dirFd);
+                    close(dirFd);
+                }
+            }
+        }
+        @catch (NSException *exception) {
+            if (!inPlace) {
+                close(dstFd);
+                unlink(tmpPath);
+            }
+            [self _loadHeader];
+            @throw;
         }
         
-        // get end size
-        savedSize = oldSize - fileHandle.offsetInFile;
-        
-        // write header
-        [fileHandle seekToFileOffset:0];
-        [fileHandle writeData:header];
-        [fileHandle synchronizeFile];
+        [self _loadHeader];
+        [self _addSectorStatisticsAllocated:0 freed:0];
+        [_chunkCache _removeChunksOfRegion:cacheID];
+    }
+    @finally {
+        pthread_rwlock_unlock(&lock);
+        free(buf);
     }
     
     return savedSize;
@@ -239,21 +1016,13 @@
 
 - (BOOL)isEmpty
 {
-    @synchronized(self) {
-        // check header
-        [fileHandle seekToEndOfFile];
-        if (fileHandle.offsetInFile < 8192) return YES;
-        
-        // read header
-        [fileHandle seekToFileOffset:0];
-        NSData *header = [fileHandle readDataOfLength:4096];
-        for (NSUInteger i=0; i < 1024; i++) {
-            uint32_t loc = OSReadBigInt32(header.bytes, 4*i);
-            if (loc != 0) return NO; // there's a chunk
-        }
+    BOOL empty = YES;
+    pthread_rwlock_rdlock(&lock);
+    for (NSUInteger i=0; i < 1024 && empty; i++) {
+        if (locations[i] != 0) empty = NO; // there's a chunk
     }
-    
-    return YES;
+    pthread_rwlock_unlock(&lock);
+    return empty;
 }
 
 @end
@@ -0,0 +1,107 @@
+//
+//  MCWorld.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "MCRegion.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** @class MCWorld
+ * Represents a directory of region files (r.X.Z.mca), and allows read/write access to its chunks in world chunk coordinates.
+ *
+ * Regions are opened as they are needed, and kept in a pool of up to maxOpenRegions, closing the least recently used ones.
+ * A region is never open more than once, and can be used from any number of threads at once.
+ */
+@interface MCWorld : NSObject
+
+/**
+ * Creates and returns a world representing the region files in a directory.
+ * @param path Path to the directory with the region files (usually the region directory of a world save).
+ * @return A world with the region files found in the directory, or nil if the directory can't be read.
+ */
++ (nullable instancetype)worldWithRegionDirectory:(NSString*)path;
+
+/**
+ * Initializes a world representing the region files in a directory.
+ *
+ * The directory is indexed when initializing, finding the region files by name (r.X.Z.mca, or r.X.Z.mcr if there's no .mca file).
+ *
+ * @param path Path to the directory with the region files (usually the region directory of a world save).
+ * @return A world with the region files found in the directory, or nil if the directory can't be read.
+ */
+- (nullable instancetype)initWithRegionDirectory:(NSString*)path NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Path to the region directory
+@property (nonatomic, readonly) NSString *path;
+
+/// Number of region files in the world
+@property (nonatomic, readonly) NSUInteger regionCount;
+
+/// Maximum number of region files kept open when they aren't in use (64 by default)
+@property (nonatomic) NSUInteger maxOpenRegions;
+
+/// Cache of decoded chunks used by the regions, or nil
+@property (nullable, strong) MCChunkCache *chunkCache;
+
+/// Read chunks with NBTInternStrings, sharing repeated keys, strings and small numbers between them
+@property (nonatomic) BOOL internStrings;
+
+/**
+ * Gets a chunk from the world.
+ *
+ * @param x X coordinate of the chunk
+ * @param z Z coordinate of the chunk
+ * @return the chunk's root tag, or nil if the chunk is empty
+ */
+- (nullable NSMutableDictionary*)getChunkAtX:(NSInteger)x Z:(NSInteger)z;
+
+/**
+ * Writes a chunk to the world, or removes it.
+ *
+ * If the region file for the chunk doesn't exist, it's created.
+ * This method raises an exception if no free space is left on the file system, or if any other writing error occurs.
+ *
+ * @param root root tag of the chunk. Pass nil to remove the chunk.
+ * @param x X coordinate of the chunk
+ * @param z Z coordinate of the chunk
+ * @param opts Write options.
+ * @return YES on success, NO if the chunk is invalid or its region file isn't valid
+ * @see -[MCRegion setChunk:atX:Z:options:]
+ */
+- (BOOL)setChunk:(nullable NSDictionary*)root atX:(NSInteger)x Z:(NSInteger)z options:(MCRegionWriteOptions)opts;
+
+/**
+ * Decodes all the chunks in the world in parallel.
+ *
+ * By default, regions are enumerated one at a time, and the block is called on the calling thread, in chunk index order within each region.
+ * With MCRegionEnumerationConcurrent, regions are enumerated in parallel, and the block is called from worker threads and must be thread safe.
+ * This method returns after all the calls to the block have finished. If reading a chunk raises an exception, the enumeration
+ * stops and the exception is raised on the calling thread.
+ *
+ * @param opts Enumeration options.
+ * @param block Block called for each chunk, with its root tag, world coordinates and timestamp. Set *stop to YES to stop enumerating.
+ */
+- (void)enumerateChunksWithOptions:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop))block;
+
+/**
+ * Decodes the chunks of the world within a bounding box in parallel.
+ *
+ * @param minX Lowest X coordinate of the chunks to decode.
+ * @param minZ Lowest Z coordinate of the chunks to decode.
+ * @param maxX Highest X coordinate of the chunks to decode (inclusive).
+ * @param maxZ Highest Z coordinate of the chunks to decode (inclusive).
+ * @param opts Enumeration options.
+ * @param block Block called for each chunk, with its root tag, world coordinates and timestamp. Set *stop to YES to stop enumerating.
+ * @see enumerateChunksWithOptions:usingBlock:
+ */
+- (void)enumerateChunksFromX:(NSInteger)minX Z:(NSInteger)minZ toX:(NSInteger)maxX Z:(NSInteger)maxZ options:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,320 @@
+//
+//  MCWorld.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "MCWorld.h"
+#import "NBTKit_Private.h"
+#import <pthread.h>
+
+#define MCWorldDefaultMaxOpenRegions 64
+
+// region coordinates packed in a number, ordered by z then x
+static inline NSNumber *MCWorldRegionKey(NSInteger rx, NSInteger rz)
+{
+    return @((int64_t)rz * 0x100000000LL + (uint32_t)rx);
+}
+
+static inline NSInteger MCWorldRegionKeyX(NSNumber *key)
+{
+    return (int32_t)(uint32_t)key.longLongValue;
+}
+
+static inline NSInteger MCWorldRegionKeyZ(NSNumber *key)
+{
+    return (NSInteger)(key.longLongValue >> 32);
+}
+
+// an open region, and the number of threads using it
+@interface MCWorldRegion : NSObject
+{
+    @public
+    MCRegion *region;
+    NSUInteger users;
+}
+@end
+
+@implementation MCWorldRegion
+@end
+
+@implementation MCWorld
+{
+    pthread_mutex_t lock;
+    // paths of the region files, keyed by region coordinates
+    NSMutableDictionary<NSNumber*, NSString*> *regionPaths;
+    // open regions, and their keys from least to most recently used
+    NSMutableDictionary<NSNumber*, MCWorldRegion*> *openRegions;
+    NSMutableOrderedSet<NSNumber*> *recentRegions;
+    NSUInteger maxOpenRegions;
+    MCChunkCache *chunkCache;
+    BOOL internStrings;
+}
+
++ (instancetype)worldWithRegionDirectory:(NSString *)path
+{
+    return [[self alloc] initWithRegionDirectory:path];
+}
+
+- (instancetype)initWithRegionDirectory:(NSString *)aPath
+{
+    if ((self = [super init])) {
+        NSArray<NSString*> *names = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:aPath error:NULL];
+        if (names == nil) return nil;
+        _path = aPath.copy;
+        pthread_mutex_init(&lock, NULL);
+        regionPaths = [NSMutableDictionary dictionaryWithCapacity:names.count];
+        openRegions = [NSMutableDictionary dictionary];
+        recentRegions = [NSMutableOrderedSet orderedSet];
+        maxOpenRegions = MCWorldDefaultMaxOpenRegions;
+        
+        // index region files by name
+        for (NSString *name in names) {
+            int rx, rz, length = 0;
+            char ext[4];
+            const char *cname = name.UTF8String;
+            if (sscanf(cname, "r.%d.%d.%3s%n", &rx, &rz, ext, &length) != 3 || cname[length] != '\0') continue;
+            BOOL anvil = strcmp(ext, "mca") == 0;
+            if (!anvil && strcmp(ext, "mcr") != 0) continue;
+            NSNumber *key = MCWorldRegionKey(rx, rz);
+            if (anvil || regionPaths[key] == nil) regionPaths[key] = [_path stringByAppendingPathComponent:name];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&lock);
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)regionCount
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger count = regionPaths.count;
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+- (NSUInteger)maxOpenRegions
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger value = maxOpenRegions;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (void)setMaxOpenRegions:(NSUInteger)value
+{
+    pthread_mutex_lock(&lock);
+    maxOpenRegions = value;
+    [self _closeUnusedRegions];
+    pthread_mutex_unlock(&lock);
+}
+
+- (MCChunkCache *)chunkCache
+{
+    pthread_mutex_lock(&lock);
+    MCChunkCache *value = chunkCache;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (void)setChunkCache:(MCChunkCache *)value
+{
+    pthread_mutex_lock(&lock);
+    chunkCache = value;
+    for (MCWorldRegion *entry in openRegions.objectEnumerator) {
+        entry->region.chunkCache = value;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+- (BOOL)internStrings
+{
+    pthread_mutex_lock(&lock);
+    BOOL value = internStrings;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+- (void)setInternStrings:(BOOL)value
+{
+    pthread_mutex_lock(&lock);
+    internStrings = value;
+    for (MCWorldRegion *entry in openRegions.objectEnumerator) {
+        entry->region.internStrings = value;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+#pragma mark - Region pool
+
+// returns an open region and marks it as used, or nil if it doesn't exist and create is NO, or isn't valid
+- (MCRegion*)_acquireRegionX:(NSInteger)rx Z:(NSInteger)rz create:(BOOL)create
+{
+    NSNumber *key = MCWorldRegionKey(rx, rz);
+    pthread_mutex_lock(&lock);
+    MCWorldRegion *entry = openRegions[key];
+    if (entry == nil) {
+        NSString *regionPath = regionPaths[key];
+        if (regionPath == nil && create) {
+            regionPath = [_path stringByAppendingPathComponent:[NSString stringWithFormat:@"r.%ld.%ld.mca", (long)rx, (long)rz]];
+        }
+        
+        // open the file without blocking other regions, another thread may open it meanwhile
+        pthread_mutex_unlock(&lock);
+        MCRegion *region = regionPath ? [[MCRegion alloc] _initWithFileAtPath:regionPath create:create] : nil;
+        pthread_mutex_lock(&lock);
+        entry = openRegions[key];
+        if (entry == nil) {
+            if (region == nil) {
+                pthread_mutex_unlock(&lock);
+                return nil;
+            }
+            region.internStrings = internStrings;
+            region.chunkCache = chunkCache;
+            regionPaths[key] = regionPath;
+            entry = [MCWorldRegion new];
+            entry->region = region;
+            openRegions[key] = entry;
+        }
+    }
+    entry->users++;
+    [recentRegions removeObject:key];
+    [recentRegions addObject:key];
+    [self _closeUnusedRegions];
+    MCRegion *region = entry->region;
+    pthread_mutex_unlock(&lock);
+    return region;
+}
+
+- (void)_releaseRegionX:(NSInteger)rx Z:(NSInteger)rz
+{
+    pthread_mutex_lock(&lock);
+    MCWorldRegion *entry = openRegions[MCWorldRegionKey(rx, rz)];
+    entry->users--;
+    [self _closeUnusedRegions];
+    pthread_mutex_unlock(&lock);
+}
+
+// closes the least recently used regions that aren't in use, until there are at most maxOpenRegions open, the lock must be held
+- (void)_closeUnusedRegions
+{
+    for (NSUInteger i=0; i < recentRegions.count && openRegions.count > maxOpenRegions;) {
+        NSNumber *key = recentRegions[i];
+        MCWorldRegion *entry = openRegions[key];
+        if (entry->users) {
+            i++;
+            continue;
+        }
+        // the file is closed when the region is released
+        [openRegions removeObjectForKey:key];
+        [recentRegions removeObjectAtIndex:i];
+    }
+}
+
+#pragma mark - Chunks
+
+- (NSMutableDictionary *)getChunkAtX:(NSInteger)x Z:(NSInteger)z
+{
+    MCRegion *region = [self _acquireRegionX:x >> 5 Z:z >> 5 create:NO];
+    if (region == nil) return nil;
+    @try {
+        return [region getChunkAtX:x & 31 Z:z & 31];
+    }
+    @finally {
+        [self _releaseRegionX:x >> 5 Z:z >> 5];
+    }
+}
+
+- (BOOL)setChunk:(NSDictionary *)root atX:(NSInteger)x Z:(NSInteger)z options:(MCRegionWriteOptions)opts
+{
+    MCRegion *region = [self _acquireRegionX:x >> 5 Z:z >> 5 create:root != nil];
+    if (region == nil) return root == nil;
+    @try {
+        return [region setChunk:root atX:x & 31 Z:z & 31 options:opts];
+    }
+    @finally {
+        [self _releaseRegionX:x >> 5 Z:z >> 5];
+    }
+}
+
+- (void)enumerateChunksWithOptions:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *, NSInteger, NSInteger, NSDate *, BOOL *))block
+{
+    [self enumerateChunksFromX:NSIntegerMin Z:NSIntegerMin toX:NSIntegerMax Z:NSIntegerMax options:opts usingBlock:block];
+}
+
+- (void)enumerateChunksFromX:(NSInteger)minX Z:(NSInteger)minZ toX:(NSInteger)maxX Z:(NSInteger)maxZ options:(MCRegionEnumerationOptions)opts usingBlock:(void (^)(NSMutableDictionary *, NSInteger, NSInteger, NSDate *, BOOL *))block
+{
+    // regions in the box, in order
+    NSMutableArray<NSNumber*> *keys = [NSMutableArray array];
+    pthread_mutex_lock(&lock);
+    for (NSNumber *key in regionPaths) {
+        NSInteger rx = MCWorldRegionKeyX(key), rz = MCWorldRegionKeyZ(key);
+        if (rx >= minX >> 5 && rx <= maxX >> 5 && rz >= minZ >> 5 && rz <= maxZ >> 5) [keys addObject:key];
+    }
+    pthread_mutex_unlock(&lock);
+    [keys sortUsingSelector:@selector(compare:)];
+    
+    __block volatile BOOL stop = NO;
+    void (^enumerateRegion)(NSNumber*, MCRegionEnumerationOptions) = ^(NSNumber *key, MCRegionEnumerationOptions regionOpts) {
+        NSInteger rx = MCWorldRegionKeyX(key), rz = MCWorldRegionKeyZ(key);
+        NSInteger x0 = rx * 32, z0 = rz * 32;
+        
+        // chunks of the region in the box
+        NSUInteger lxMin = minX > x0 ? minX - x0 : 0, lxMax = maxX < x0 + 31 ? maxX - x0 : 31;
+        NSUInteger lzMin = minZ > z0 ? minZ - z0 : 0, lzMax = maxZ < z0 + 31 ? maxZ - z0 : 31;
+        NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+        for (NSUInteger lz = lzMin; lz <= lzMax; lz++) {
+            [indexes addIndexesInRange:NSMakeRange(lz * 32 + lxMin, lxMax - lxMin + 1)];
+        }
+        
+        MCRegion *region = [self _acquireRegionX:rx Z:rz create:NO];
+        if (region == nil) return;
+        @try {
+            [region enumerateChunksAtIndexes:indexes options:regionOpts usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *regionStop) {
+                BOOL blockStop = stop;
+                if (!blockStop) block(root, x0 + x, z0 + z, timestamp, &blockStop);
+                if (blockStop) stop = *regionStop = YES;
+            }];
+        }
+        @finally {
+            [self _releaseRegionX:rx Z:rz];
+        }
+    };
+    
+    if (opts & MCRegionEnumerationConcurrent) {
+        // regions in parallel, each decoding its chunks in parallel too, exceptions are raised on this thread
+        void **exceptions = calloc(keys.count, sizeof(void*));
+        dispatch_apply(keys.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            if (stop) return;
+            @autoreleasepool {
+                @try {
+                    enumerateRegion(keys[i], MCRegionEnumerationConcurrent);
+                }
+                @catch (NSException *exception) {
+                    exceptions[i] = (void*)CFBridgingRetain(exception);
+                    stop = YES;
+                }
+            }
+        });
+        NSException *firstException = nil;
+        for (NSUInteger i=0; i < keys.count; i++) {
+            NSException *exception = CFBridgingRelease(exceptions[i]);
+            if (firstException == nil) firstException = exception;
+        }
+        free(exceptions);
+        if (firstException) @throw firstException;
+    } else {
+        for (NSUInteger i=0; i < keys.count && !stop; i++) {
+            enumerateRegion(keys[i], 0);
+        }
+    }
+}
+
+@end
@@ -0,0 +1,103 @@
+//
+//  NBTByteSwap.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+// Bulk byte order conversion for int and long arrays.
+
+#ifndef NBTKit_NBTByteSwap_h
+#define NBTKit_NBTByteSwap_h
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define NBTHostIsLittleEndian (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// Copies count 32-bit values from src to dst swapping their byte order, src and dst may be the same
+static inline void NBTSwapInt32s(void *dst, const void *src, size_t count)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12, 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + 4*i));
+        _mm256_storeu_si256((__m256i*)(d + 4*i), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i mask128 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + 4*i));
+        _mm_storeu_si128((__m128i*)(d + 4*i), _mm_shuffle_epi8(v, mask128));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u8(d + 4*i, vrev32q_u8(vld1q_u8(s + 4*i)));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t v;
+        memcpy(&v, s + 4*i, 4);
+        v = __builtin_bswap32(v);
+        memcpy(d + 4*i, &v, 4);
+    }
+}
+
+// Copies count 64-bit values from src to dst swapping their byte order, src and dst may be the same
+static inline void NBTSwapInt64s(void *dst, const void *src, size_t count)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8, 7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+    for (; i + 4 <= count; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + 8*i));
+        _mm256_storeu_si256((__m256i*)(d + 8*i), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i mask128 = _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+    for (; i + 2 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + 8*i));
+        _mm_storeu_si128((__m128i*)(d + 8*i), _mm_shuffle_epi8(v, mask128));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 2 <= count; i += 2) {
+        vst1q_u8(d + 8*i, vrev64q_u8(vld1q_u8(s + 8*i)));
+    }
+#endif
+    for (; i < count; i++) {
+        uint64_t v;
+        memcpy(&v, s + 8*i, 8);
+        v = __builtin_bswap64(v);
+        memcpy(d + 8*i, &v, 8);
+    }
+}
+
+// Copies count values of size 4 or 8 from src to dst, swapping them if needed, src and dst may be the same
+static inline void NBTCopyValues(void *dst, const void *src, size_t count, size_t size, int swap)
+{
+    if (!swap) {
+        if (dst != src) memmove(dst, src, count * size);
+    } else if (size == sizeof(int32_t)) {
+        NBTSwapInt32s(dst, src, count);
+    } else {
+        NBTSwapInt64s(dst, src, count);
+    }
+}
+
+#endif
@@ -0,0 +1,29 @@
+//
+//  NBTCompound.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @class NBTCompound
+ *
+ * Mutable dictionary that keeps its keys in insertion order, used for TAG_Compound when reading.
+ *
+ * Enumerating an NBTCompound (keyEnumerator, fast enumeration, allKeys) returns its keys in order,
+ * and nbtOrderedKeys is taken from that order instead of being rebuilt. Setting the value of an existing key
+ * doesn't change its position, and copies keep the same order.
+ *
+ * copy returns an immutable NBTCompound, which raises NSInternalInconsistencyException when mutated, while
+ * mutableCopy returns a mutable one.
+ */
+@interface NBTCompound<KeyType, ObjectType> : NSMutableDictionary<KeyType, ObjectType>
+
+@end
+
+NS_ASSUME_NONNULL_END
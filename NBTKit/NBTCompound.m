@@ -0,0 +1,151 @@
+//
+//  NBTCompound.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTCompound.h"
+#import "NBTKit.h"
+
+@implementation NBTCompound
+{
+    NSMutableDictionary *dict;
+    NSMutableArray *keys;
+    // set in copies, which raise on mutation
+    BOOL frozen;
+}
+
+- (instancetype)init
+{
+    return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)numItems
+{
+    if ((self = [super init])) {
+        dict = [[NSMutableDictionary alloc] initWithCapacity:numItems];
+        keys = [[NSMutableArray alloc] initWithCapacity:numItems];
+    }
+    return self;
+}
+
+- (instancetype)initWithObjects:(const id _Nonnull [])objects forKeys:(const id<NSCopying> _Nonnull [])theKeys count:(NSUInteger)cnt
+{
+    if ((self = [self initWithCapacity:cnt])) {
+        for (NSUInteger i=0; i < cnt; i++) {
+            [self setObject:objects[i] forKey:theKeys[i]];
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithCompound:(NBTCompound*)compound frozen:(BOOL)isFrozen
+{
+    if ((self = [super init])) {
+        dict = [compound->dict mutableCopy];
+        keys = [compound->keys mutableCopy];
+        frozen = isFrozen;
+    }
+    return self;
+}
+
+- (void)_checkMutable:(SEL)selector
+{
+    if (frozen) [NSException raise:NSInternalInconsistencyException format:@"*** -[%@ %@]: mutating method sent to immutable object", self.class, NSStringFromSelector(selector)];
+}
+
+#pragma mark - Primitive methods
+
+- (NSUInteger)count
+{
+    return dict.count;
+}
+
+- (id)objectForKey:(id)aKey
+{
+    return [dict objectForKey:aKey];
+}
+
+- (NSEnumerator *)keyEnumerator
+{
+    return keys.objectEnumerator;
+}
+
+- (void)setObject:(id)anObject forKey:(id<NSCopying>)aKey
+{
+    [self _checkMutable:_cmd];
+    if (anObject == nil) {
+        [NSException raise:NSInvalidArgumentException format:@"*** %s: object cannot be nil (key: %@)", __PRETTY_FUNCTION__, aKey];
+    }
+    NSUInteger oldCount = dict.count;
+    id key = [aKey copyWithZone:nil];
+    [dict setObject:anObject forKey:key];
+    if (dict.count != oldCount) [keys addObject:key];
+}
+
+- (void)removeObjectForKey:(id)aKey
+{
+    [self _checkMutable:_cmd];
+    if ([dict objectForKey:aKey] == nil) return;
+    [dict removeObjectForKey:aKey];
+    // search from the end, keys are most often removed right after being added
+    NSUInteger index = [keys indexOfObjectWithOptions:NSEnumerationReverse passingTest:^BOOL(id key, NSUInteger idx, BOOL *stop) {
+        return [key isEqual:aKey];
+    }];
+    [keys removeObjectAtIndex:index];
+}
+
+#pragma mark - Faster overrides
+
+- (void)removeAllObjects
+{
+    [self _checkMutable:_cmd];
+    [dict removeAllObjects];
+    [keys removeAllObjects];
+}
+
+- (NSArray *)allKeys
+{
+    return [keys copy];
+}
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id __unsafe_unretained _Nonnull [])buffer count:(NSUInteger)len
+{
+    return [keys countByEnumeratingWithState:state objects:buffer count:len];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    if (frozen) return self;
+    return [[NBTCompound allocWithZone:zone] initWithCompound:self frozen:YES];
+}
+
+- (id)mutableCopyWithZone:(NSZone *)zone
+{
+    return [[NBTCompound allocWithZone:zone] initWithCompound:self frozen:NO];
+}
+
+#pragma mark - Key order
+
+- (NSOrderedSet<NSString*>*)nbtOrderedKeys
+{
+    return [NSOrderedSet orderedSetWithArray:keys];
+}
+
+- (void)setNbtOrderedKeys:(NSOrderedSet<NSString*>*)nbtOrderedKeys
+{
+    [self _checkMutable:_cmd];
+    // keys in the given order first, then the ones it doesn't have in their current order
+    NSMutableArray *newKeys = [NSMutableArray arrayWithCapacity:keys.count];
+    for (NSString *key in nbtOrderedKeys) {
+        if ([dict objectForKey:key]) [newKeys addObject:key];
+    }
+    for (id key in keys) {
+        if (![nbtOrderedKeys containsObject:key]) [newKeys addObject:key];
+    }
+    keys = newKeys;
+}
+
+@end
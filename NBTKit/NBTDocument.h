@@ -0,0 +1,116 @@
+//
+//  NBTDocument.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "NBTKit.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Handle to a tag in a NBTDocument.
+ *
+ * Handles are only meaningful for the document they were obtained from.
+ */
+typedef uint64_t NBTNode;
+
+/// Returned when a node doesn't exist
+#define NBTNodeNotFound ((NBTNode)UINT64_MAX)
+
+/**
+ * @class NBTDocument
+ *
+ * Compact, read-only representation of NBT data.
+ *
+ * The whole document is stored in a single allocation, holding the NBT data and a flat table of nodes,
+ * and values are only decoded when asked for. Tags are accessed through NBTNode handles, and can be
+ * converted to Foundation objects with objectForNode:.
+ */
+@interface NBTDocument : NSObject
+
+/**
+ * Creates a document from NBT data.
+ *
+ * @param data The NBT data to read.
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed and NBTLittleEndian
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ * @return A new document, or nil if an error occurs.
+ */
++ (nullable instancetype)documentWithData:(NSData*)data options:(NBTOptions)opt error:(NSError **)error;
+
+/**
+ * Creates a document from a root tag made of Foundation objects.
+ *
+ * @param root Root tag.
+ * @param name Name of the root tag, or nil for no name.
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ * @return A new document, or nil if an error occurs.
+ */
++ (nullable instancetype)documentWithRootTag:(NSDictionary*)root name:(nullable NSString*)name error:(NSError **)error;
+
+/// Name of the root tag
+@property (nonatomic, readonly) NSString *rootName;
+
+/// The root compound
+@property (nonatomic, readonly) NBTNode rootNode;
+
+/// Number of nodes in the document's table
+@property (nonatomic, readonly) NSUInteger nodeCount;
+
+/// Type of a tag
+- (NBTType)typeOfNode:(NBTNode)node;
+
+/// Type of the items in a list
+- (NBTType)listTypeOfNode:(NBTNode)node;
+
+/// Name of a tag in a compound, nil for list items
+- (nullable NSString*)nameOfNode:(NBTNode)node;
+
+/// Number of tags in a compound or list, values in an array, or bytes in a string
+- (NSUInteger)countOfNode:(NBTNode)node;
+
+/// Tag in a compound with a given name, or NBTNodeNotFound
+- (NBTNode)childOfNode:(NBTNode)node named:(NSString*)name;
+
+/// Tag at an index of a compound or list, or NBTNodeNotFound
+- (NBTNode)childOfNode:(NBTNode)node atIndex:(NSUInteger)index;
+
+/**
+ * Tag at a path from the root compound, or NBTNodeNotFound.
+ *
+ * Paths are made of tag names separated by dots, and list items are addressed by their index (e.g. @"Level.Sections.0.Y").
+ */
+- (NBTNode)nodeAtPath:(NSString*)path;
+
+/// Value of a byte, short, int or long tag
+- (int64_t)integerValueOfNode:(NBTNode)node;
+
+/// Value of a float or double tag
+- (double)doubleValueOfNode:(NBTNode)node;
+
+/// Value of a string tag
+- (nullable NSString*)stringValueOfNode:(NBTNode)node;
+
+/**
+ * Copies values of a byte, int or long array in host byte order.
+ *
+ * @param buffer Destination for the values (int8_t, int32_t or int64_t).
+ * @param range Range of values to copy.
+ * @param node The array.
+ * @return Number of values copied.
+ */
+- (NSUInteger)getValues:(void*)buffer range:(NSRange)range ofNode:(NBTNode)node;
+
+/// Converts a tag and its contents to Foundation objects, as returned by NBTKit's reading methods
+- (nullable id)objectForNode:(NBTNode)node;
+
+/// The root compound converted to Foundation objects
+- (NSMutableDictionary*)rootTag;
+
+@end
+
+NS_ASSUME_NONNULL_END
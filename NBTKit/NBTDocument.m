@@ -0,0 +1,529 @@
+//
+//  NBTDocument.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTDocument.h"
+#import "NBTKit_Private.h"
+#import "NBTByteSwap.h"
+
+#define NBTDocumentMaxDepth 512
+#define NBTDocumentNoName UINT32_MAX
+
+typedef struct {
+    // offset of the name's length in the data, NBTDocumentNoName for list items
+    uint32_t name;
+    // offset of the payload, after the length for strings, lists and arrays
+    uint32_t value;
+    // tags in a compound or list, values in an array, or bytes in a string
+    uint32_t count;
+    // index of the first child, children of a node are contiguous
+    uint32_t children;
+    int8_t type, listType;
+} NBTDocumentNode;
+
+typedef struct {
+    const uint8_t *bytes;
+    uint64_t length, pos;
+    BOOL littleEndian;
+    // number of children of each node that has child nodes, in the order they're found
+    uint32_t *counts;
+    size_t numCounts, countsCapacity, nextCount;
+    uint64_t nodes;
+    NBTDocumentNode *table;
+    uint32_t nextNode;
+} NBTDocumentScanner;
+
+// size of a value of a fixed size type, or 0
+static size_t NBTDocumentFixedSize(int8_t type)
+{
+    switch (type) {
+        case NBTTypeByte: return 1;
+        case NBTTypeShort: return 2;
+        case NBTTypeInt:
+        case NBTTypeFloat: return 4;
+        case NBTTypeLong:
+        case NBTTypeDouble: return 8;
+        default: return 0;
+    }
+}
+
+static size_t NBTDocumentArrayValueSize(int8_t type)
+{
+    return type == NBTTypeByteArray ? 1 : type == NBTTypeIntArray ? 4 : type == NBTTypeLongArray ? 8 : 0;
+}
+
+static inline uint16_t NBTDocumentReadShort(const uint8_t *bytes, BOOL littleEndian)
+{
+    return littleEndian ? OSReadLittleInt16(bytes, 0) : OSReadBigInt16(bytes, 0);
+}
+
+static inline int32_t NBTDocumentReadInt(const uint8_t *bytes, BOOL littleEndian)
+{
+    return littleEndian ? OSReadLittleInt32(bytes, 0) : OSReadBigInt32(bytes, 0);
+}
+
+static inline int64_t NBTDocumentReadLong(const uint8_t *bytes, BOOL littleEndian)
+{
+    return littleEndian ? OSReadLittleInt64(bytes, 0) : OSReadBigInt64(bytes, 0);
+}
+
+#pragma mark - Scanning
+
+static BOOL NBTDocumentSkip(NBTDocumentScanner *s, uint64_t len)
+{
+    if (s->length - s->pos < len) return NO;
+    s->pos += len;
+    return YES;
+}
+
+static BOOL NBTDocumentScanLength(NBTDocumentScanner *s, size_t size, uint64_t *len)
+{
+    if (s->length - s->pos < size) return NO;
+    if (size == 2) {
+        *len = NBTDocumentReadShort(s->bytes + s->pos, s->littleEndian);
+    } else {
+        int32_t val = NBTDocumentReadInt(s->bytes + s->pos, s->littleEndian);
+        if (val < 0) return NO;
+        *len = val;
+    }
+    s->pos += size;
+    return YES;
+}
+
+static BOOL NBTDocumentAddCount(NBTDocumentScanner *s, uint32_t count)
+{
+    if (s->numCounts == s->countsCapacity) {
+        s->countsCapacity = MAX(2 * s->countsCapacity, 256);
+        s->counts = reallocf(s->counts, s->countsCapacity * sizeof(uint32_t));
+        if (s->counts == NULL) return NO;
+    }
+    s->counts[s->numCounts++] = count;
+    s->nodes += count;
+    return YES;
+}
+
+// first pass: checks the data and counts the nodes
+static BOOL NBTDocumentScanTag(NBTDocumentScanner *s, int8_t type, int depth)
+{
+    if (depth > NBTDocumentMaxDepth) return NO;
+    size_t size = NBTDocumentFixedSize(type);
+    if (size) return NBTDocumentSkip(s, size);
+    
+    uint64_t len;
+    switch (type) {
+        case NBTTypeString:
+            return NBTDocumentScanLength(s, 2, &len) && NBTDocumentSkip(s, len);
+        case NBTTypeByteArray:
+        case NBTTypeIntArray:
+        case NBTTypeLongArray:
+            return NBTDocumentScanLength(s, 4, &len) && NBTDocumentSkip(s, len * NBTDocumentArrayValueSize(type));
+        case NBTTypeList: {
+            if (s->pos == s->length) return NO;
+            int8_t listType = s->bytes[s->pos++];
+            if (!NBTDocumentScanLength(s, 4, &len)) return NO;
+            size = NBTDocumentFixedSize(listType);
+            // values of fixed size types and empty lists don't have child nodes
+            if (size || len == 0) return NBTDocumentSkip(s, len * size);
+            if (!NBTDocumentAddCount(s, (uint32_t)len)) return NO;
+            while (len--) {
+                if (!NBTDocumentScanTag(s, listType, depth + 1)) return NO;
+            }
+            return YES;
+        }
+        case NBTTypeCompound: {
+            size_t index = s->numCounts;
+            if (!NBTDocumentAddCount(s, 0)) return NO;
+            for (;;) {
+                if (s->pos == s->length) return NO;
+                int8_t tag = s->bytes[s->pos++];
+                if (tag == NBTTypeEnd) return YES;
+                if (!NBTDocumentScanLength(s, 2, &len) || !NBTDocumentSkip(s, len)) return NO;
+                s->counts[index]++;
+                s->nodes++;
+                if (!NBTDocumentScanTag(s, tag, depth + 1)) return NO;
+            }
+        }
+        default:
+            return NO;
+    }
+}
+
+// second pass: fills in a node whose type and name are set, and its children
+static void NBTDocumentFillNode(NBTDocumentScanner *s, uint32_t index)
+{
+    NBTDocumentNode *node = &s->table[index];
+    const uint8_t *bytes = s->bytes;
+    size_t size = NBTDocumentFixedSize(node->type);
+    if (size) {
+        node->value = (uint32_t)s->pos;
+        s->pos += size;
+        return;
+    }
+    
+    switch (node->type) {
+        case NBTTypeString:
+            node->count = NBTDocumentReadShort(bytes + s->pos, s->littleEndian);
+            node->value = (uint32_t)s->pos + 2;
+            s->pos += 2 + node->count;
+            break;
+        case NBTTypeByteArray:
+        case NBTTypeIntArray:
+        case NBTTypeLongArray:
+            node->count = NBTDocumentReadInt(bytes + s->pos, s->littleEndian);
+            node->value = (uint32_t)s->pos + 4;
+            s->pos += 4 + (uint64_t)node->count * NBTDocumentArrayValueSize(node->type);
+            break;
+        case NBTTypeList: {
+            node->listType = bytes[s->pos];
+            node->count = NBTDocumentReadInt(bytes + s->pos + 1, s->littleEndian);
+            node->value = (uint32_t)s->pos + 5;
+            s->pos += 5;
+            size = NBTDocumentFixedSize(node->listType);
+            if (size || node->count == 0) {
+                s->pos += (uint64_t)node->count * size;
+                break;
+            }
+            uint32_t first = s->nextNode, count = s->counts[s->nextCount++];
+            s->nextNode += count;
+            node->children = first;
+            for (uint32_t i=0; i < count; i++) {
+                s->table[first + i].type = node->listType;
+                s->table[first + i].name = NBTDocumentNoName;
+                NBTDocumentFillNode(s, first + i);
+            }
+            break;
+        }
+        case NBTTypeCompound: {
+            uint32_t first = s->nextNode, count = s->counts[s->nextCount++];
+            s->nextNode += count;
+            node->children = first;
+            node->count = count;
+            for (uint32_t i=0; i < count; i++) {
+                NBTDocumentNode *child = &s->table[first + i];
+                child->type = bytes[s->pos++];
+                child->name = (uint32_t)s->pos;
+                s->pos += 2 + NBTDocumentReadShort(bytes + s->pos, s->littleEndian);
+                NBTDocumentFillNode(s, first + i);
+            }
+            s->pos++; // TAG_End
+            break;
+        }
+    }
+}
+
+#pragma mark -
+
+@implementation NBTDocument
+{
+    // node table followed by the NBT data
+    void *arena;
+    NBTDocumentNode *table;
+    const uint8_t *bytes;
+    NSUInteger length;
+    BOOL littleEndian;
+}
+
++ (instancetype)documentWithData:(NSData *)data options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    if (data == nil) return nil;
+    if (opt & NBTCompressed) {
+        data = [NBTKit _inflateData:data error:error];
+        if (data == nil) return nil;
+    }
+    return [[self alloc] initWithBytes:data.bytes length:data.length littleEndian:opt & NBTLittleEndian error:error];
+}
+
++ (instancetype)documentWithRootTag:(NSDictionary *)root name:(NSString *)name error:(NSError *__autoreleasing *)error
+{
+    return [self documentWithData:[NBTKit dataWithNBT:root name:name options:0 error:error] options:0 error:error];
+}
+
+- (instancetype)initWithBytes:(const uint8_t*)srcBytes length:(NSUInteger)srcLength littleEndian:(BOOL)le error:(NSError **)error
+{
+    if ((self = [super init])) {
+        uint64_t start = NBTStatisticsStart();
+        
+        // check the data and count nodes
+        NBTDocumentScanner s = {.bytes = srcBytes, .length = srcLength, .littleEndian = le, .nodes = 1};
+        uint64_t len;
+        BOOL valid = srcLength > 0 && srcLength < UINT32_MAX && srcBytes[0] == NBTTypeCompound;
+        if (valid) {
+            s.pos = 1;
+            valid = NBTDocumentScanLength(&s, 2, &len) && NBTDocumentSkip(&s, len) && NBTDocumentScanTag(&s, NBTTypeCompound, 0) && s.nodes < UINT32_MAX;
+        }
+        if (!valid) {
+            free(s.counts);
+            if (error) *error = [NBTKit _errorFromException:[NSException exceptionWithName:@"NBTReadException" reason:@"Error reading NBT." userInfo:@{
+                NSLocalizedFailureReasonErrorKey: @"Error reading NBT.",
+                NSStreamFileCurrentOffsetKey: @(s.pos)
+            }]];
+            return nil;
+        }
+        
+        // one allocation for the node table and the data
+        size_t tableSize = (size_t)s.nodes * sizeof(NBTDocumentNode);
+        arena = calloc(1, tableSize + srcLength);
+        if (arena == NULL) {
+            free(s.counts);
+            return nil;
+        }
+        table = arena;
+        bytes = (uint8_t*)arena + tableSize;
+        length = srcLength;
+        littleEndian = le;
+        _nodeCount = (NSUInteger)s.nodes;
+        memcpy((void*)bytes, srcBytes, srcLength);
+        
+        // fill node table
+        s.bytes = bytes;
+        s.table = table;
+        s.pos = 3 + NBTDocumentReadShort(bytes + 1, le);
+        s.nextNode = 1;
+        table[0].type = NBTTypeCompound;
+        table[0].name = 1;
+        NBTDocumentFillNode(&s, 0);
+        free(s.counts);
+        NBTStatisticsAddTime(NBTStatisticParseTime, start);
+        NBTStatisticsAdd(NBTStatisticBytesRead, srcLength);
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(arena);
+}
+
+#pragma mark - Nodes
+
+// handles of items in lists of fixed size values have the item index + 1 in the high 32 bits
+static inline uint32_t NBTNodeIndex(NBTNode node) { return (uint32_t)node; }
+static inline uint32_t NBTNodeItem(NBTNode node) { return (uint32_t)(node >> 32); }
+
+- (const NBTDocumentNode*)nodeForHandle:(NBTNode)node
+{
+    if (NBTNodeIndex(node) >= _nodeCount) return NULL;
+    const NBTDocumentNode *n = &table[NBTNodeIndex(node)];
+    if (NBTNodeItem(node) > n->count) return NULL;
+    return n;
+}
+
+// offset of the value
+- (uint32_t)valueOfNode:(NBTNode)node type:(NBTType*)type
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL) {
+        *type = NBTTypeInvalid;
+        return 0;
+    } else if (NBTNodeItem(node)) {
+        *type = n->listType;
+        return n->value + (NBTNodeItem(node) - 1) * (uint32_t)NBTDocumentFixedSize(n->listType);
+    }
+    *type = n->type;
+    return n->value;
+}
+
+- (NBTNode)rootNode
+{
+    return 0;
+}
+
+- (NSString *)rootName
+{
+    return [self nameOfNode:0] ?: @"";
+}
+
+- (NBTType)typeOfNode:(NBTNode)node
+{
+    NBTType type;
+    [self valueOfNode:node type:&type];
+    return type;
+}
+
+- (NBTType)listTypeOfNode:(NBTNode)node
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node) || n->type != NBTTypeList) return NBTTypeInvalid;
+    return n->listType;
+}
+
+- (NSString *)nameOfNode:(NBTNode)node
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node) || n->name == NBTDocumentNoName) return nil;
+    return [[NSString alloc] initWithBytes:bytes + n->name + 2 length:NBTDocumentReadShort(bytes + n->name, littleEndian) encoding:NSUTF8StringEncoding];
+}
+
+- (NSUInteger)countOfNode:(NBTNode)node
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node)) return 0;
+    return n->count;
+}
+
+- (NBTNode)childOfNode:(NBTNode)node named:(NSString *)name
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node) || n->type != NBTTypeCompound) return NBTNodeNotFound;
+    const char *cname = name.UTF8String;
+    size_t len = strlen(cname);
+    for (uint32_t i=0; i < n->count; i++) {
+        uint32_t nameOffset = table[n->children + i].name;
+        if (NBTDocumentReadShort(bytes + nameOffset, littleEndian) == len && memcmp(bytes + nameOffset + 2, cname, len) == 0) return n->children + i;
+    }
+    return NBTNodeNotFound;
+}
+
+- (NBTNode)childOfNode:(NBTNode)node atIndex:(NSUInteger)index
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node) || index >= n->count) return NBTNodeNotFound;
+    if (n->type == NBTTypeCompound) {
+        return n->children + index;
+    } else if (n->type == NBTTypeList) {
+        if (NBTDocumentFixedSize(n->listType)) return (NBTNode)(index + 1) << 32 | NBTNodeIndex(node);
+        return n->children + index;
+    }
+    return NBTNodeNotFound;
+}
+
+- (NBTNode)nodeAtPath:(NSString *)path
+{
+    NBTNode node = self.rootNode;
+    for (NSString *component in [path componentsSeparatedByString:@"."]) {
+        NBTType type = [self typeOfNode:node];
+        if (type == NBTTypeCompound) {
+            node = [self childOfNode:node named:component];
+        } else if (type == NBTTypeList) {
+            NSScanner *scanner = [NSScanner scannerWithString:component];
+            NSInteger index;
+            if (![scanner scanInteger:&index] || !scanner.atEnd || index < 0) return NBTNodeNotFound;
+            node = [self childOfNode:node atIndex:index];
+        } else {
+            return NBTNodeNotFound;
+        }
+    }
+    return node;
+}
+
+#pragma mark - Values
+
+- (int64_t)integerValueOfNode:(NBTNode)node
+{
+    NBTType type;
+    uint32_t offset = [self valueOfNode:node type:&type];
+    switch (type) {
+        case NBTTypeByte: return (int8_t)bytes[offset];
+        case NBTTypeShort: return (int16_t)NBTDocumentReadShort(bytes + offset, littleEndian);
+        case NBTTypeInt: return NBTDocumentReadInt(bytes + offset, littleEndian);
+        case NBTTypeLong: return NBTDocumentReadLong(bytes + offset, littleEndian);
+        default: return 0;
+    }
+}
+
+- (double)doubleValueOfNode:(NBTNode)node
+{
+    NBTType type;
+    uint32_t offset = [self valueOfNode:node type:&type];
+    if (type == NBTTypeFloat) {
+        int32_t val = NBTDocumentReadInt(bytes + offset, littleEndian);
+        return *(float*)&val;
+    } else if (type == NBTTypeDouble) {
+        int64_t val = NBTDocumentReadLong(bytes + offset, littleEndian);
+        return *(double*)&val;
+    }
+    return 0.0;
+}
+
+- (NSString *)stringValueOfNode:(NBTNode)node
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node) || n->type != NBTTypeString) return nil;
+    return [[NSString alloc] initWithBytes:bytes + n->value length:n->count encoding:NSUTF8StringEncoding];
+}
+
+- (NSUInteger)getValues:(void *)buffer range:(NSRange)range ofNode:(NBTNode)node
+{
+    const NBTDocumentNode *n = [self nodeForHandle:node];
+    if (n == NULL || NBTNodeItem(node)) return 0;
+    size_t size = NBTDocumentArrayValueSize(n->type);
+    if (size == 0 || range.location >= n->count) return 0;
+    NSUInteger count = MIN(range.length, n->count - range.location);
+    NBTCopyValues(buffer, bytes + n->value + range.location * size, count, size, size > 1 && littleEndian != NBTHostIsLittleEndian);
+    return count;
+}
+
+#pragma mark - Conversion
+
+- (id)objectForNode:(NBTNode)node
+{
+    NBTType type = [self typeOfNode:node];
+    switch (type) {
+        case NBTTypeByte:
+            return NBTByte([self integerValueOfNode:node]);
+        case NBTTypeShort:
+            return NBTShort([self integerValueOfNode:node]);
+        case NBTTypeInt:
+            return NBTInt([self integerValueOfNode:node]);
+        case NBTTypeLong:
+            return NBTLong([self integerValueOfNode:node]);
+        case NBTTypeFloat:
+            return NBTFloat([self doubleValueOfNode:node]);
+        case NBTTypeDouble:
+            return NBTDouble([self doubleValueOfNode:node]);
+        case NBTTypeString:
+            return [self stringValueOfNode:node];
+        case NBTTypeByteArray: {
+            NSMutableData *byteArray = [NSMutableData dataWithLength:[self countOfNode:node]];
+            [self getValues:byteArray.mutableBytes range:NSMakeRange(0, byteArray.length) ofNode:node];
+            return byteArray;
+        }
+        case NBTTypeIntArray: {
+            NBTIntArray *intArray = [NBTIntArray intArrayWithCount:[self countOfNode:node]];
+            [self getValues:intArray.values range:NSMakeRange(0, intArray.count) ofNode:node];
+            return intArray;
+        }
+        case NBTTypeLongArray: {
+            NBTLongArray *longArray = [NBTLongArray longArrayWithCount:[self countOfNode:node]];
+            [self getValues:longArray.values range:NSMakeRange(0, longArray.count) ofNode:node];
+            return longArray;
+        }
+        case NBTTypeList: {
+            NSUInteger count = [self countOfNode:node];
+            NSMutableArray *list = [NSMutableArray arrayWithCapacity:count];
+            for (NSUInteger i=0; i < count; i++) {
+                id item = [self objectForNode:[self childOfNode:node atIndex:i]];
+                if (item == nil) return nil;
+                [list addObject:item];
+            }
+            list.nbtListType = [self listTypeOfNode:node];
+            return list;
+        }
+        case NBTTypeCompound: {
+            NSUInteger count = [self countOfNode:node];
+            NBTCompound *compound = [[NBTCompound alloc] initWithCapacity:count];
+            for (NSUInteger i=0; i < count; i++) {
+                NBTNode child = [self childOfNode:node atIndex:i];
+                NSString *name = [self nameOfNode:child];
+                id value = [self objectForNode:child];
+                if (name == nil || value == nil) return nil;
+                compound[name] = value;
+            }
+            return compound;
+        }
+        default:
+            return nil;
+    }
+}
+
+- (NSMutableDictionary *)rootTag
+{
+    return [self objectForNode:self.rootNode];
+}
+
+@end
@@ -0,0 +1,185 @@
+//
+//  NBTHash.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+// Streaming 64-bit hash (XXH64) of NBT payloads, used to detect unchanged chunks
+
+#ifndef NBTKit_NBTHash_h
+#define NBTKit_NBTHash_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define NBTHashPrime1 0x9E3779B185EBCA87ULL
+#define NBTHashPrime2 0xC2B2AE3D27D4EB4FULL
+#define NBTHashPrime3 0x165667B19E3779F9ULL
+#define NBTHashPrime4 0x85EBCA77C2B2AE63ULL
+#define NBTHashPrime5 0x27D4EB2F165667C5ULL
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total;
+    uint8_t buf[32];
+    size_t bufLength;
+} NBTHashState;
+
+static inline uint64_t NBTHashRotate(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t NBTHashRead64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t NBTHashRead32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t NBTHashRound(uint64_t acc, uint64_t input)
+{
+    return NBTHashRotate(acc + input * NBTHashPrime2, 31) * NBTHashPrime1;
+}
+
+static inline uint64_t NBTHashMerge(uint64_t acc, uint64_t v)
+{
+    return (acc ^ NBTHashRound(0, v)) * NBTHashPrime1 + NBTHashPrime4;
+}
+
+static inline void NBTHashInit(NBTHashState *state)
+{
+    memset(state, 0, sizeof *state);
+    state->v[0] = NBTHashPrime1 + NBTHashPrime2;
+    state->v[1] = NBTHashPrime2;
+    state->v[2] = 0;
+    state->v[3] = 0 - NBTHashPrime1;
+}
+
+// consumes 32-byte stripes, returns the number of bytes consumed
+static inline size_t NBTHashStripes(NBTHashState *state, const uint8_t *p, size_t len)
+{
+    const uint8_t *start = p;
+    uint64_t v0 = state->v[0], v1 = state->v[1], v2 = state->v[2], v3 = state->v[3];
+    for (; len >= 32; p += 32, len -= 32) {
+        v0 = NBTHashRound(v0, NBTHashRead64(p));
+        v1 = NBTHashRound(v1, NBTHashRead64(p + 8));
+        v2 = NBTHashRound(v2, NBTHashRead64(p + 16));
+        v3 = NBTHashRound(v3, NBTHashRead64(p + 24));
+    }
+    state->v[0] = v0; state->v[1] = v1; state->v[2] = v2; state->v[3] = v3;
+    return p - start;
+}
+
+static inline void NBTHashUpdate(NBTHashState *state, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    state->total += len;
+    if (state->bufLength) {
+        // complete the buffered stripe
+        size_t n = 32 - state->bufLength < len ? 32 - state->bufLength : len;
+        memcpy(state->buf + state->bufLength, p, n);
+        state->bufLength += n;
+        p += n;
+        len -= n;
+        if (state->bufLength < 32) return;
+        NBTHashStripes(state, state->buf, 32);
+        state->bufLength = 0;
+    }
+    size_t consumed = NBTHashStripes(state, p, len);
+    memcpy(state->buf, p + consumed, len - consumed);
+    state->bufLength = len - consumed;
+}
+
+static inline uint64_t NBTHashFinal(const NBTHashState *state)
+{
+    uint64_t h;
+    if (state->total >= 32) {
+        h = NBTHashRotate(state->v[0], 1) + NBTHashRotate(state->v[1], 7) + NBTHashRotate(state->v[2], 12) + NBTHashRotate(state->v[3], 18);
+        for (int i=0; i < 4; i++) h = NBTHashMerge(h, state->v[i]);
+    } else {
+        h = NBTHashPrime5;
+    }
+    h += state->total;
+    
+    const uint8_t *p = state->buf;
+    size_t len = state->bufLength;
+    for (; len >= 8; p += 8, len -= 8) {
+        h = NBTHashRotate(h ^ NBTHashRound(0, NBTHashRead64(p)), 27) * NBTHashPrime1 + NBTHashPrime4;
+    }
+    if (len >= 4) {
+        h = NBTHashRotate(h ^ (NBTHashRead32(p) * NBTHashPrime1), 23) * NBTHashPrime2 + NBTHashPrime3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--) {
+        h = NBTHashRotate(h ^ (*p * NBTHashPrime5), 11) * NBTHashPrime1;
+    }
+    
+    h ^= h >> 33;
+    h *= NBTHashPrime2;
+    h ^= h >> 29;
+    h *= NBTHashPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t NBTHash(const void *data, size_t len)
+{
+    NBTHashState state;
+    NBTHashInit(&state);
+    NBTHashUpdate(&state, data, len);
+    return NBTHashFinal(&state);
+}
+
+// 32-bit XXH32, used for the checksums of LZ4 blocks
+static inline uint32_t NBTHash32(const void *data, size_t len, uint32_t seed)
+{
+    const uint32_t p1 = 0x9E3779B1U, p2 = 0x85EBCA77U, p3 = 0xC2B2AE3DU, p4 = 0x27D4EB2FU, p5 = 0x165667B1U;
+    const uint8_t *p = data, *end = p + len;
+    uint32_t h;
+    if (len >= 16) {
+        uint32_t v[4] = {seed + p1 + p2, seed + p2, seed, seed - p1};
+        for (; end - p >= 16; p += 16) {
+            for (int i=0; i < 4; i++) {
+                v[i] += NBTHashRead32(p + 4*i) * p2;
+                v[i] = ((v[i] << 13) | (v[i] >> 19)) * p1;
+            }
+        }
+        h = ((v[0] << 1) | (v[0] >> 31)) + ((v[1] << 7) | (v[1] >> 25)) + ((v[2] << 12) | (v[2] >> 20)) + ((v[3] << 18) | (v[3] >> 14));
+    } else {
+        h = seed + p5;
+    }
+    h += (uint32_t)len;
+    for (; end - p >= 4; p += 4) {
+        h += NBTHashRead32(p) * p3;
+        h = ((h << 17) | (h >> 15)) * p4;
+    }
+    for (; p < end; p++) {
+        h += *p * p5;
+        h = ((h << 11) | (h >> 21)) * p1;
+    }
+    h ^= h >> 15;
+    h *= p2;
+    h ^= h >> 13;
+    h *= p3;
+    h ^= h >> 16;
+    return h;
+}
+
+#endif
@@ -16,6 +16,9 @@ NS_ASSUME_NONNULL_BEGIN
  * Represents a variable-sized array of 32-bit integers.
  *
  * NBTIntArray objects allocate more memory as needed when elements are added.
+ *
+ * Methods that don't modify the array, including -values, can be called from several threads at once.
+ * Modifying an array while other threads access it is not supported.
  */
 @interface NBTIntArray : NSObject <NSCopying>
 
@@ -117,7 +120,7 @@ NS_ASSUME_NONNULL_BEGIN
  * Returns the receiver's values.
  *
  * The returned value is a pointer to the object's internal storage, it may not be valid after subsequent
- * calls to this object.
+ * modifications of the receiver. Values of arrays read from NBT data are decoded the first time this is called.
  *
  * @return pointer to the receiver's internal values.
  */
@@ -0,0 +1,53 @@
+//
+//  NBTInternTable.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "NBTNumbers.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @class NBTInternTable
+ *
+ * Table of canonical instances of short strings and small numbers, used instead of creating new objects for each
+ * compound key, string value, byte and short read, when reading with the NBTInternStrings option.
+ *
+ * A table can be shared by any number of readers, and used from any thread. It keeps up to a fixed number of strings,
+ * after which new strings are returned without being added to it.
+ */
+@interface NBTInternTable : NSObject
+
+/// Table used when reading with the NBTInternStrings option
+@property (class, nonatomic, readonly) NBTInternTable *sharedTable;
+
+/// Number of strings in the table
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Returns the canonical string with the given UTF-8 bytes.
+ *
+ * Strings longer than 64 bytes are not interned, and a new string is returned for them.
+ *
+ * @param bytes UTF-8 bytes of the string.
+ * @param length Number of bytes.
+ * @return An immutable string, or nil if the bytes aren't valid UTF-8.
+ */
+- (nullable NSString *)stringWithUTF8Bytes:(const void *)bytes length:(NSUInteger)length;
+
+/// Returns the shared instance of a NBTByte value
+- (NBTByte *)byteWithValue:(int8_t)value;
+
+/// Returns the shared instance of a small NBTShort value (-128 to 1023), or a new one for other values
+- (NBTShort *)shortWithValue:(int16_t)value;
+
+/// Removes all strings from the table, strings already returned stay valid
+- (void)removeAllStrings;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,199 @@
+//
+//  NBTInternTable.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTInternTable.h"
+#import "NBTKit_Private.h"
+#import <pthread.h>
+
+#define NBTInternMaxLength      64
+#define NBTInternMaxCount       (16*1024)
+#define NBTInternShortMin       -128
+#define NBTInternShortMax       1023
+
+typedef struct {
+    uint32_t hash;
+    uint32_t length;
+    uint8_t *bytes;
+    CFStringRef string;
+} NBTInternEntry;
+
+// FNV-1a
+static inline uint32_t NBTInternHash(const uint8_t *bytes, NSUInteger length)
+{
+    uint32_t hash = 2166136261u;
+    for (NSUInteger i=0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static inline BOOL NBTIsASCII(const uint8_t *bytes, NSUInteger length)
+{
+    uint64_t bits = 0;
+    NSUInteger i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        bits |= word;
+    }
+    for (; i < length; i++) bits |= bytes[i];
+    return (bits & 0x8080808080808080ULL) == 0;
+}
+
+// returns the entry with the given bytes, or the empty entry where it would go
+static inline NBTInternEntry *NBTInternFind(NBTInternEntry *entries, NSUInteger capacity, const uint8_t *bytes, NSUInteger length, uint32_t hash)
+{
+    NSUInteger mask = capacity - 1;
+    for (NSUInteger i = hash & mask;; i = (i + 1) & mask) {
+        NBTInternEntry *entry = &entries[i];
+        if (entry->bytes == NULL || (entry->hash == hash && entry->length == length && memcmp(entry->bytes, bytes, length) == 0)) {
+            return entry;
+        }
+    }
+}
+
+@implementation NBTInternTable
+{
+    pthread_rwlock_t lock;
+    NBTInternEntry *entries;
+    NSUInteger capacity, count;
+    CFTypeRef byteValues[256];
+    CFTypeRef shortValues[NBTInternShortMax - NBTInternShortMin + 1];
+}
+
++ (NBTInternTable *)sharedTable
+{
+    static NBTInternTable *sharedTable;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedTable = [NBTInternTable new];
+    });
+    return sharedTable;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        pthread_rwlock_init(&lock, NULL);
+        capacity = 1024;
+        entries = calloc(capacity, sizeof(NBTInternEntry));
+        for (int i=0; i < 256; i++) {
+            byteValues[(uint8_t)(i - 128)] = CFBridgingRetain(NBTByte(i - 128));
+        }
+        for (int i=NBTInternShortMin; i <= NBTInternShortMax; i++) {
+            shortValues[i - NBTInternShortMin] = CFBridgingRetain(NBTShort(i));
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self removeAllStrings];
+    free(entries);
+    for (int i=0; i < 256; i++) CFRelease(byteValues[i]);
+    for (int i=0; i <= NBTInternShortMax - NBTInternShortMin; i++) CFRelease(shortValues[i]);
+    pthread_rwlock_destroy(&lock);
+}
+
+- (NSUInteger)count
+{
+    pthread_rwlock_rdlock(&lock);
+    NSUInteger n = count;
+    pthread_rwlock_unlock(&lock);
+    return n;
+}
+
+- (NBTByte *)byteWithValue:(int8_t)value
+{
+    return (__bridge NBTByte *)byteValues[(uint8_t)value];
+}
+
+- (NBTShort *)shortWithValue:(int16_t)value
+{
+    if (value < NBTInternShortMin || value > NBTInternShortMax) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+        return NBTShort(value);
+    }
+    return (__bridge NBTShort *)shortValues[value - NBTInternShortMin];
+}
+
+- (NSString *)stringWithUTF8Bytes:(const void *)someBytes length:(NSUInteger)length
+{
+    if (length == 0) return @"";
+    if (length > NBTInternMaxLength) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+        return [[NSString alloc] initWithBytes:someBytes length:length encoding:NSUTF8StringEncoding];
+    }
+    
+    // look it up, most strings are found
+    uint32_t hash = NBTInternHash(someBytes, length);
+    NSString *string = nil;
+    pthread_rwlock_rdlock(&lock);
+    NBTInternEntry *entry = NBTInternFind(entries, capacity, someBytes, length, hash);
+    if (entry->bytes) string = (__bridge NSString *)entry->string;
+    pthread_rwlock_unlock(&lock);
+    if (string) return string;
+    
+    // ASCII doesn't need to be decoded as UTF-8
+    if (NBTIsASCII(someBytes, length)) {
+        string = CFBridgingRelease(CFStringCreateWithBytes(kCFAllocatorDefault, someBytes, length, kCFStringEncodingASCII, false));
+    } else {
+        string = [[NSString alloc] initWithBytes:someBytes length:length encoding:NSUTF8StringEncoding];
+    }
+    if (string == nil) return nil;
+    NBTStatisticsAdd(NBTStatisticAllocations, 1);
+    
+    pthread_rwlock_wrlock(&lock);
+    if (count < NBTInternMaxCount) {
+        if ((count + 1) * 2 > capacity) [self _grow];
+        // another thread may have added it since
+        entry = NBTInternFind(entries, capacity, someBytes, length, hash);
+        if (entry->bytes) {
+            string = (__bridge NSString *)entry->string;
+        } else {
+            entry->hash = hash;
+            entry->length = (uint32_t)length;
+            entry->bytes = malloc(length);
+            memcpy(entry->bytes, someBytes, length);
+            entry->string = CFBridgingRetain(string);
+            count++;
+        }
+    }
+    pthread_rwlock_unlock(&lock);
+    return string;
+}
+
+// doubles the capacity, the lock must be held for writing
+- (void)_grow
+{
+    NSUInteger newCapacity = capacity * 2;
+    NBTInternEntry *newEntries = calloc(newCapacity, sizeof(NBTInternEntry));
+    for (NSUInteger i=0; i < capacity; i++) {
+        if (entries[i].bytes == NULL) continue;
+        *NBTInternFind(newEntries, newCapacity, entries[i].bytes, entries[i].length, entries[i].hash) = entries[i];
+    }
+    free(entries);
+    entries = newEntries;
+    capacity = newCapacity;
+}
+
+- (void)removeAllStrings
+{
+    pthread_rwlock_wrlock(&lock);
+    for (NSUInteger i=0; i < capacity; i++) {
+        if (entries[i].bytes == NULL) continue;
+        free(entries[i].bytes);
+        CFRelease(entries[i].string);
+    }
+    memset(entries, 0, capacity * sizeof(NBTInternEntry));
+    count = 0;
+    pthread_rwlock_unlock(&lock);
+}
+
+@end
@@ -11,7 +11,11 @@
 #import "NBTNumbers.h"
 #import "NBTIntArray.h"
 #import "NBTLongArray.h"
+#import "NBTCompound.h"
+#import "NBTInternTable.h"
+#import "MCChunkCache.h"
 #import "MCRegion.h"
+#import "MCWorld.h"
 
 /**
 * Represents a type of value in a NBT
@@ -52,8 +56,28 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
     NBTCompressed =     1 << 1,
     /// Used for writing chunks within region files (combine this flag with NBTCompressed)
     NBTUseZlib =        1 << 2,
+    /// Read repeated short strings and small bytes and shorts as shared instances from NBTInternTable.sharedTable
+    NBTInternStrings =  1 << 3,
+    /// Compression level used for writing, set with NBTCompressionLevel(level)
+    NBTCompressionLevelMask =       0xF << 8,
+    /// Deflate strategies used for writing (same as zlib's), the default is Z_DEFAULT_STRATEGY
+    NBTCompressionFiltered =        1 << 12,
+    NBTCompressionHuffmanOnly =     2 << 12,
+    NBTCompressionRLE =             3 << 12,
+    NBTCompressionFixed =           4 << 12,
+    NBTCompressionStrategyMask =    7 << 12,
 };
 
+/**
+ * Returns the option for writing compressed data with a given zlib compression level.
+ *
+ * @param level Compression level from 0 (no compression) to 9 (best compression), or -1 for zlib's default.
+ * @return Option to combine with NBTCompressed.
+ */
+NS_INLINE NBTOptions NBTCompressionLevel(int level) {
+    return (NBTOptions)((MAX(MIN(level, 9), -1) + 1) << 8);
+}
+
 @interface NBTKit : NSObject
 
 /**
@@ -63,7 +87,7 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
  *
  * @param data The NBT data to read.
  * @param name Upon return contains the name of the root tag. Pass NULL if not needed.
- * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed and NBTLittleEndian
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
  * @param error If an error occurs, upon return contains an NSError object that describes the problem.
  *
  * @return A NSMutableDictionary with the root tag, or nil if an error occurs.
@@ -77,7 +101,7 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
  *
  * @param path Path to the NBT file to read.
  * @param name Upon return contains the name of the root tag. Pass NULL if not needed.
- * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed and NBTLittleEndian
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
  * @param error If an error occurs, upon return contains an NSError object that describes the problem.
  *
  * @return A NSMutableDictionary with the root tag, or nil if an error occurs.
@@ -91,19 +115,34 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
  *
  * @param stream Stream to read from.
  * @param name Upon return contains the name of the root tag. Pass NULL if not needed.
- * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed and NBTLittleEndian
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
  * @param error If an error occurs, upon return contains an NSError object that describes the problem.
  *
  * @return A NSMutableDictionary with the root tag, or nil if an error occurs.
  */
 + (nullable NSMutableDictionary<NSString*,NSObject*>*)NBTWithStream:(NSInputStream *)stream name:(NSString *_Nullable *_Nullable)name options:(NBTOptions)opt error:(NSError **)error;
 
+/**
+ * Returns the values at some paths in the root tag of NBT data, without reading the rest.
+ *
+ * Paths are made of tag names separated by dots, starting at the root compound (e.g. @"Level.xPos"), and list items are addressed by their index (e.g. @"Level.Sections.0.Y").
+ * Tags that aren't part of a path are skipped without being read, and reading stops as soon as all the paths have been found.
+ *
+ * @param paths Paths of the values to read.
+ * @param data The NBT data to read.
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ *
+ * @return A dictionary with the values found, keyed by path, or nil if an error occurs. Paths that aren't present in the data are left out.
+ */
++ (nullable NSDictionary<NSString*,id>*)valuesAtPaths:(NSArray<NSString*>*)paths inData:(NSData *)data options:(NBTOptions)opt error:(NSError **)error;
+
 /**
  * Returns NBT data from a NSDictionary
  *
  * @param base Root tag.
  * @param name Name of the root tag, or nil for no name.
- * @param opt A combination of NBTOptions or zero. To write with Zlib compression, you must use both NBTCompressed and NBTUseZlib options.
+ * @param opt A combination of NBTOptions or zero. To write with Zlib compression, you must use both NBTCompressed and NBTUseZlib options. The compression level and strategy can be set with NBTCompressionLevel() and the NBTCompression options.
  * @param error If an error occurs, upon return contains an NSError object that describes the problem.
  * @return NSData object with the written data
  */
@@ -124,6 +163,8 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
 /**
  * Writes NBT data to a file
  *
+ * The data is written to a temporary file that replaces the destination only if writing succeeds.
+ *
  * @param base Root tag.
  * @param name Name of the root tag, or nil for no name.
  * @param path Destination for the NBT data.
@@ -133,6 +174,60 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
  */
 + (NSInteger)writeNBT:(NSDictionary*)base name:(nullable NSString*)name toFile:(NSString *)path options:(NBTOptions)opt error:(NSError **)error;
 
+/**
+ * Returns the SNBT (stringified NBT, as used in Minecraft commands) representation of an object.
+ *
+ * The types of numbers and arrays are kept with their suffixes (1b, 2s, 3, 4L, 5.0f, 6.0d) and prefixes ([B;...], [I;...], [L;...]),
+ * so it can be read back as the same NBT.
+ *
+ * @param obj Any valid NBT object.
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ * @return SNBT string, or nil if an error occurs.
+ */
++ (nullable NSString *)SNBTWithNBT:(id)obj error:(NSError **)error;
+
+/**
+ * Returns the SNBT representation of an object, as UTF-8 data.
+ *
+ * @param obj Any valid NBT object.
+ * @param opt A combination of NBTOptions or zero. Only the compression options are used.
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ * @return NSData object with the written text, or nil if an error occurs.
+ */
++ (nullable NSData *)SNBTDataWithNBT:(id)obj options:(NBTOptions)opt error:(NSError **)error;
+
+/**
+ * Writes the SNBT representation of an object to a stream, as UTF-8.
+ *
+ * @param obj Any valid NBT object.
+ * @param stream Destination for the SNBT text.
+ * @param opt A combination of NBTOptions or zero. Only the compression options are used.
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem.
+ * @return Number of bytes written, 0 on failure
+ */
++ (NSInteger)writeSNBT:(id)obj toStream:(NSOutputStream *)stream options:(NBTOptions)opt error:(NSError **)error;
+
+/**
+ * Returns the NBT object represented by a SNBT string.
+ *
+ * Compounds are read as NBTCompound, and lists as NSMutableArray. Unquoted strings, true and false, and doubles without suffix are accepted.
+ *
+ * @param string SNBT to read.
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem, with the offset of the error.
+ * @return The NBT object, or nil if an error occurs.
+ */
++ (nullable id)NBTWithSNBT:(NSString *)string error:(NSError **)error;
+
+/**
+ * Returns the NBT object represented by SNBT data.
+ *
+ * @param data UTF-8 SNBT text to read.
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed and NBTInternStrings
+ * @param error If an error occurs, upon return contains an NSError object that describes the problem, with the offset of the error.
+ * @return The NBT object, or nil if an error occurs.
+ */
++ (nullable id)NBTWithSNBTData:(NSData *)data options:(NBTOptions)opt error:(NSError **)error;
+
 /**
  * Returns a Boolean value that indicates whether a given object can be converted to NBT data.
  *
@@ -180,3 +275,7 @@ typedef NS_OPTIONS(NSUInteger, NBTOptions) {
 @end
 
 NS_ASSUME_NONNULL_END
+
+#import "NBTParser.h"
+#import "NBTDocument.h"
+#import "NBTStatistics.h"
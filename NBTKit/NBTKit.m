@@ -10,102 +10,307 @@
 #import "NBTKit_Private.h"
 #import "NBTReader.h"
 #import "NBTWriter.h"
+#import "NBTSNBTReader.h"
 #import <zlib.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <objc/runtime.h>
 
 NSErrorDomain const NBTKitErrorDomain = @"NBTKitErrorDomain";
 
+static NBTType NBTTypeOfClassUncached(id obj)
+{
+    if ([obj isKindOfClass:[NBTByte class]])        return NBTTypeByte;
+    if ([obj isKindOfClass:[NBTShort class]])       return NBTTypeShort;
+    if ([obj isKindOfClass:[NBTInt class]])         return NBTTypeInt;
+    if ([obj isKindOfClass:[NBTLong class]])        return NBTTypeLong;
+    if ([obj isKindOfClass:[NBTFloat class]])       return NBTTypeFloat;
+    if ([obj isKindOfClass:[NBTDouble class]])      return NBTTypeDouble;
+    if ([obj isKindOfClass:[NSString class]])       return NBTTypeString;
+    if ([obj isKindOfClass:[NSDictionary class]])   return NBTTypeCompound;
+    if ([obj isKindOfClass:[NSArray class]])        return NBTTypeList;
+    if ([obj isKindOfClass:[NSData class]])         return NBTTypeByteArray;
+    if ([obj isKindOfClass:[NBTIntArray class]])    return NBTTypeIntArray;
+    if ([obj isKindOfClass:[NBTLongArray class]])   return NBTTypeLongArray;
+    return NBTTypeInvalid;
+}
+
+static BOOL NBTClassIsProxy(Class cls)
+{
+    Class proxy = [NSProxy class];
+    for (; cls != Nil; cls = class_getSuperclass(cls)) {
+        if (cls == proxy) return YES;
+    }
+    return NO;
+}
+
+// Class -> NBTType cache, open addressed and lock-free. A slot's type is
+// stored before its class is published, so a reader that finds the class
+// always sees its type. Entries are never removed; when the table is full
+// the type is just computed each time.
+#define NBTTypeCacheSize 512
+#define NBTTypeCacheProbes 8
+static _Atomic(uintptr_t) typeCacheClasses[NBTTypeCacheSize];
+static _Atomic(uint8_t) typeCacheTypes[NBTTypeCacheSize];
+
+NBTType NBTTypeOfObject(id obj)
+{
+    if (obj == nil) return NBTTypeInvalid;
+    uintptr_t cls = (uintptr_t)object_getClass(obj);
+    size_t slot = (cls >> 4) % NBTTypeCacheSize;
+    for (int i = 0; i < NBTTypeCacheProbes; i++) {
+        uintptr_t found = atomic_load_explicit(&typeCacheClasses[(slot + i) % NBTTypeCacheSize], memory_order_acquire);
+        if (found == cls) return atomic_load_explicit(&typeCacheTypes[(slot + i) % NBTTypeCacheSize], memory_order_relaxed);
+        if (found == 0) break;
+    }
+    
+    // miss: a proxy's type depends on its target, so it can't be cached by class
+    NBTType type = NBTTypeOfClassUncached(obj);
+    if (NBTClassIsProxy((Class)cls)) return type;
+    for (int i = 0; i < NBTTypeCacheProbes; i++) {
+        size_t index = (slot + i) % NBTTypeCacheSize;
+        uintptr_t expected = 0;
+        // claim the slot with a marker, then publish the class after its type
+        if (atomic_compare_exchange_strong(&typeCacheClasses[index], &expected, (uintptr_t)1)) {
+            atomic_store_explicit(&typeCacheTypes[index], (uint8_t)type, memory_order_relaxed);
+            atomic_store_explicit(&typeCacheClasses[index], cls, memory_order_release);
+            break;
+        }
+        if (expected == cls) break;
+    }
+    return type;
+}
+
 @implementation NBTKit
 
 + (NSMutableDictionary *)NBTWithData:(NSData *)data name:(NSString *__autoreleasing *)name options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
 {
     if (data == nil) return nil;
-    NSInputStream *stream = [NSInputStream inputStreamWithData:data];
-    [stream open];
-    return [self NBTWithStream:stream name:name options:opt error:error];
+    if (opt & NBTCompressed) {
+        data = [self _inflateData:data error:error];
+        if (data == nil) return nil;
+    } else {
+        // arrays are views over the data, it must not change under them
+        data = [data copy];
+    }
+    
+    // read uncompressed NBT
+    NBTReader *reader = [[NBTReader alloc] initWithData:data];
+    reader.littleEndian = opt & NBTLittleEndian;
+    reader.zeroCopy = YES;
+    if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    return [reader readRootTag:name error:error];
 }
 
 + (NSMutableDictionary *)NBTWithFile:(NSString *)path name:(NSString *__autoreleasing *)name options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
 {
-    NSInputStream *stream = [NSInputStream inputStreamWithFileAtPath:path];
-    [stream open];
-    return [self NBTWithStream:stream name:name options:opt error:error];
+    if (opt & NBTCompressed) {
+        // inflate while reading, without keeping the whole decompressed file
+        NSInputStream *stream = [NSInputStream inputStreamWithFileAtPath:path];
+        [stream open];
+        return [self NBTWithStream:stream name:name options:opt error:error];
+    }
+    // not mapped, arrays read from it can outlive the file's contents
+    NSData *data = [NSData dataWithContentsOfFile:path options:0 error:error];
+    return [self NBTWithData:data name:name options:opt error:error];
 }
 
 + (NSMutableDictionary *)NBTWithStream:(NSInputStream *)stream name:(NSString *__autoreleasing *)name options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
 {
-    if (opt & NBTCompressed) {
-        // read whole stream (yes, it's inefficient)
-        uint8_t buf[1024];
-        NSMutableData *zdata = [NSMutableData new];
-        while (stream.hasBytesAvailable) {
-            NSInteger br = [stream read:buf maxLength:sizeof buf];
-            if (br > 0) [zdata appendBytes:buf length:br];
-            if (br < 0) {
-                // error
-                if (error) *error = stream.streamError;
-                return nil;
+    NBTReader *reader = [[NBTReader alloc] initWithStream:stream compressed:opt & NBTCompressed];
+    reader.littleEndian = opt & NBTLittleEndian;
+    if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    return [reader readRootTag:name error:error];
+}
+
++ (NSDictionary *)valuesAtPaths:(NSArray<NSString *> *)paths inData:(NSData *)data options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    if (data == nil) return nil;
+    if (paths.count == 0) return @{};
+    // inflate only as far as needed
+    NBTReader *reader = opt & NBTCompressed ? [[NBTReader alloc] initWithStream:[NSInputStream inputStreamWithData:data] compressed:YES] : [[NBTReader alloc] initWithData:data];
+    reader.littleEndian = opt & NBTLittleEndian;
+    if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    return [reader readValuesAtPaths:paths error:error];
+}
+
++ (NSData *)_inflateData:(NSData *)zdata error:(NSError *__autoreleasing *)error
+{
+    uint64_t start = NBTStatisticsStart();
+    
+    // guess the decompressed size, gzip has it at the end
+    const uint8_t *zbytes = zdata.bytes;
+    NSUInteger zlength = zdata.length;
+    NSUInteger length = MAX(4 * zlength, 4096);
+    if (zlength > 18 && zbytes[0] == 0x1f && zbytes[1] == 0x8b) {
+        length = MAX(OSReadLittleInt32(zbytes, zlength - 4), 1);
+        length = MIN(length, 1032 * zlength);
+    }
+    
+    // decompress straight into the result
+    uint8_t *buf = malloc(length);
+    if (buf == NULL) {
+        if (error) *error = [self _errorFromZlibError:Z_MEM_ERROR];
+        return nil;
+    }
+    z_stream zstream = {
+        .zalloc   = Z_NULL,
+        .zfree    = Z_NULL,
+        .opaque   = Z_NULL,
+        .next_in  = (void*)zbytes,
+        .avail_in = (uInt)zlength
+    };
+    
+    int zerr = inflateInit2(&zstream, 15 + 32);
+    if (zerr != Z_OK) goto zlibError;
+    
+    for (;;) {
+        // grow output buffer if full
+        if (zstream.total_out == length) {
+            uint8_t *newBuf = realloc(buf, length * 2);
+            if (newBuf == NULL) {
+                zerr = Z_MEM_ERROR;
+                goto zlibError;
             }
+            buf = newBuf;
+            length *= 2;
         }
+        zstream.next_out = buf + zstream.total_out;
+        zstream.avail_out = (uInt)MIN(length - zstream.total_out, UINT_MAX);
         
-        // decompress
-        NSMutableData *nbtData = [NSMutableData new];
-        z_stream zstream = {
-            .zalloc   = Z_NULL,
-            .zfree    = Z_NULL,
-            .opaque   = Z_NULL,
-            .next_in  = (void*)zdata.bytes,
-            .avail_in = (uInt)zdata.length
-        };
-        
-        int zerr = inflateInit2(&zstream, 15 + 32);
-        if(zerr != Z_OK) goto zlibError;
-        
-        do {
-            // set output buffer
-            zstream.next_out = buf;
-            zstream.avail_out = sizeof buf;
-            
-            // inflate
-            zerr = inflate(&zstream, Z_NO_FLUSH);
-            if (zerr == Z_MEM_ERROR || zerr == Z_DATA_ERROR || zerr == Z_NEED_DICT) goto zlibError;
-            
-            // add to decompressed data
-            [nbtData appendBytes:buf length:sizeof buf - zstream.avail_out];
-        } while (zstream.avail_out == 0);
-        
-        if(zerr != Z_STREAM_END) goto zlibError;
-        inflateEnd(&zstream);
-        
-        // read uncompressed NBT
-        return [self NBTWithData:nbtData name:name options:opt &~ NBTCompressed error:error];
-    zlibError:
-        inflateEnd(&zstream);
-        if (error) *error = [NSError errorWithDomain:@"ZLib" code:zerr userInfo:@{@"message": [[NSString alloc] initWithUTF8String:zError(zerr)]}];
+        // inflate
+        zerr = inflate(&zstream, Z_NO_FLUSH);
+        if (zerr == Z_STREAM_END) break;
+        if (zerr != Z_OK) goto zlibError;
+    }
+    
+    // trim it, arrays read from it may keep it for a while
+    length = zstream.total_out;
+    buf = realloc(buf, MAX(length, 1)) ?: buf;
+    inflateEnd(&zstream);
+    NBTStatisticsAddTime(NBTStatisticInflateTime, start);
+    NBTStatisticsAdd(NBTStatisticCompressedBytesRead, zlength);
+    NBTStatisticsAdd(NBTStatisticAllocations, 1);
+    return [NSData dataWithBytesNoCopy:buf length:length freeWhenDone:YES];
+zlibError:
+    inflateEnd(&zstream);
+    free(buf);
+    if (error) *error = [self _errorFromZlibError:zerr];
+    return nil;
+}
+
++ (NSData *)_deflateData:(NSData *)data options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    uint64_t start = NBTStatisticsStart();
+    int level = MIN((int)((opt & NBTCompressionLevelMask) >> 8) - 1, Z_BEST_COMPRESSION);
+    int strategy = (int)((opt & NBTCompressionStrategyMask) >> 12);
+    z_stream zstream = {
+        .zalloc   = Z_NULL,
+        .zfree    = Z_NULL,
+        .opaque   = Z_NULL,
+        .next_in  = (void*)data.bytes,
+        .avail_in = (uInt)data.length
+    };
+    int zerr = deflateInit2(&zstream, level, Z_DEFLATED, opt & NBTUseZlib ? 15 : 31, 8, strategy);
+    if (zerr != Z_OK) {
+        if (error) *error = [self _errorFromZlibError:zerr];
+        return nil;
+    }
+    
+    // compress in one go into a buffer big enough for any input
+    NSMutableData *zdata = [NSMutableData dataWithLength:deflateBound(&zstream, data.length)];
+    zstream.next_out = zdata.mutableBytes;
+    zstream.avail_out = (uInt)zdata.length;
+    zerr = deflate(&zstream, Z_FINISH);
+    deflateEnd(&zstream);
+    if (zerr != Z_STREAM_END) {
+        if (error) *error = [self _errorFromZlibError:zerr == Z_OK ? Z_BUF_ERROR : zerr];
         return nil;
-    } else {
-        // read uncompressed NBT
-        NBTReader *reader = [[NBTReader alloc] initWithStream:stream];
-        reader.littleEndian = opt & NBTLittleEndian;
-        return [reader readRootTag:name error:error];
     }
+    zdata.length = zstream.total_out;
+    NBTStatisticsAddTime(NBTStatisticDeflateTime, start);
+    NBTStatisticsAdd(NBTStatisticCompressedBytesWritten, zdata.length);
+    return zdata;
 }
 
 + (NSData *)dataWithNBT:(NSDictionary*)root name:(NSString*)name options:(NBTOptions)opt error:(NSError **)error
 {
-    NSError *inError = nil;
-    NSOutputStream *stream = [NSOutputStream outputStreamToMemory];
-    [stream open];
-    [self writeNBT:root name:name toStream:stream options:opt error:&inError];
-    if (error) *error = inError;
-    if (inError) return nil;
-    return [stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+    // write straight into the returned data
+    NSMutableData *data = [NSMutableData dataWithCapacity:16*1024];
+    NBTWriter *writer = [[NBTWriter alloc] initWithData:data options:opt];
+    if ([writer writeRootTag:root withName:name error:error] == 0) return nil;
+    return data;
+}
+
++ (NSString *)SNBTWithNBT:(id)obj error:(NSError *__autoreleasing *)error
+{
+    NSData *data = [self SNBTDataWithNBT:obj options:0 error:error];
+    return data ? [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] : nil;
+}
+
++ (NSData *)SNBTDataWithNBT:(id)obj options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    NSMutableData *data = [NSMutableData dataWithCapacity:16*1024];
+    NBTWriter *writer = [[NBTWriter alloc] initWithData:data options:opt & ~NBTLittleEndian];
+    if ([writer writeSNBT:obj error:error] == 0) return nil;
+    return data;
+}
+
++ (NSInteger)writeSNBT:(id)obj toStream:(NSOutputStream *)stream options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    NBTWriter *writer = [[NBTWriter alloc] initWithStream:stream options:opt & ~NBTLittleEndian];
+    return [writer writeSNBT:obj error:error];
+}
+
++ (id)NBTWithSNBT:(NSString *)string error:(NSError *__autoreleasing *)error
+{
+    return [self NBTWithSNBTData:[string dataUsingEncoding:NSUTF8StringEncoding] options:0 error:error];
+}
+
++ (id)NBTWithSNBTData:(NSData *)data options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
+{
+    if (data == nil) return nil;
+    if (opt & NBTCompressed) {
+        data = [self _inflateData:data error:error];
+        if (data == nil) return nil;
+    }
+    NBTSNBTReader *reader = [[NBTSNBTReader alloc] initWithData:data];
+    if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    return [reader readValue:error];
 }
 
 + (NSInteger)writeNBT:(NSDictionary *)base name:(NSString *)name toFile:(NSString *)path options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
 {
-    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    // write through symlinks, to a temporary file next to the target, and replace it only if writing succeeds
+    char targetPath[PATH_MAX], tempPath[PATH_MAX];
+    if (realpath(path.fileSystemRepresentation, targetPath) == NULL) strlcpy(targetPath, path.fileSystemRepresentation, sizeof targetPath);
+    
+    // keep the mode of an existing file, new ones get the default permissions from the umask
+    struct stat st;
+    BOOL exists = stat(targetPath, &st) == 0;
+    int fd = -1;
+    for (int tries = 0; fd < 0 && tries < 100; tries++) {
+        snprintf(tempPath, sizeof tempPath, "%s.%08x", targetPath, arc4random());
+        fd = open(tempPath, O_WRONLY | O_CREAT | O_EXCL, exists ? st.st_mode & 07777 : 0666);
+        if (fd < 0 && errno != EEXIST) break;
+    }
+    if (fd < 0) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: path}];
+        return 0;
+    }
+    if (exists) fchmod(fd, st.st_mode & 07777);
+    close(fd);
+    
+    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:@(tempPath) append:NO];
     [stream open];
-    return [self writeNBT:base name:name toStream:stream options:opt error:error];
+    NSInteger bw = [self writeNBT:base name:name toStream:stream options:opt error:error];
+    [stream close];
+    if (bw && rename(tempPath, targetPath) != 0) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: path}];
+        bw = 0;
+    }
+    if (bw == 0) unlink(tempPath);
+    return bw;
 }
 
 + (NSInteger)writeNBT:(NSDictionary *)root name:(NSString*)name toStream:(NSOutputStream *)stream options:(NBTOptions)opt error:(NSError *__autoreleasing *)error
@@ -115,70 +320,14 @@ NSErrorDomain const NBTKitErrorDomain = @"NBTKitErrorDomain";
         return 0;
     }
     
-    if (opt & NBTCompressed) {
-        // get uncompressed data
-        NSData *nbtData = [self dataWithNBT:root name:name options:opt &~ NBTCompressed error:error];
-        if (nbtData == nil) return 0;
-        
-        // compress
-        z_stream zstream = {
-            .zalloc   = Z_NULL,
-            .zfree    = Z_NULL,
-            .opaque   = Z_NULL,
-            .next_in  = (void*)nbtData.bytes,
-            .avail_in = (uInt)nbtData.length
-        };
-        
-        uint8_t buf[1024];
-        int zerr = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, opt & NBTUseZlib ? 15 : 31, 8, Z_DEFAULT_STRATEGY);
-        if (zerr != Z_OK) goto zlibError;
-        
-        NSInteger bw = 0;
-        do {
-            zstream.next_out = buf;
-            zstream.avail_out = sizeof buf;
-            
-            zerr = deflate(&zstream, Z_FINISH);
-            if (zerr == Z_STREAM_ERROR) goto zlibError;
-            
-            bw += [stream write:buf maxLength:sizeof buf - zstream.avail_out];
-        } while (zstream.avail_out == 0);
-        
-        deflateEnd(&zstream);
-        return bw;
-    zlibError:
-        deflateEnd(&zstream);
-        if (error) *error = [NSError errorWithDomain:@"ZLib" code:zerr userInfo:@{@"message": [[NSString alloc] initWithUTF8String:zError(zerr)]}];
-        return 0;
-    } else {
-        // check types
-        if (![self isValidNBTObject:root]) {
-            if (error) *error = [NSError errorWithDomain:NBTKitErrorDomain code:NBTTypeError userInfo:@{NSLocalizedFailureReasonErrorKey: @"Invalid NBT object"}];
-            return 0;
-        }
-        
-        // write NBT
-        NBTWriter *writer = [[NBTWriter alloc] initWithStream:stream];
-        writer.littleEndian = opt & NBTLittleEndian;
-        return [writer writeRootTag:root withName:name error:error];
-    }
+    // compressed data is deflated as it's written
+    NBTWriter *writer = [[NBTWriter alloc] initWithStream:stream options:opt];
+    return [writer writeRootTag:root withName:name error:error];
 }
 
 + (NBTType)NBTTypeForObject:(id)obj
 {
-    if ([obj isKindOfClass:[NBTByte class]])        return NBTTypeByte;
-    if ([obj isKindOfClass:[NBTShort class]])       return NBTTypeShort;
-    if ([obj isKindOfClass:[NBTInt class]])         return NBTTypeInt;
-    if ([obj isKindOfClass:[NBTLong class]])        return NBTTypeLong;
-    if ([obj isKindOfClass:[NBTFloat class]])       return NBTTypeFloat;
-    if ([obj isKindOfClass:[NBTDouble class]])      return NBTTypeDouble;
-    if ([obj isKindOfClass:[NSData class]])         return NBTTypeByteArray;
-    if ([obj isKindOfClass:[NSString class]])       return NBTTypeString;
-    if ([obj isKindOfClass:[NSArray class]])        return NBTTypeList;
-    if ([obj isKindOfClass:[NSDictionary class]])   return NBTTypeCompound;
-    if ([obj isKindOfClass:[NBTIntArray class]])    return NBTTypeIntArray;
-    if ([obj isKindOfClass:[NBTLongArray class]])   return NBTTypeLongArray;
-    return NBTTypeInvalid;
+    return NBTTypeOfObject(obj);
 }
 
 + (Class)classForNBTType:(NBTType)type {
@@ -255,10 +404,10 @@ NSErrorDomain const NBTKitErrorDomain = @"NBTKitErrorDomain";
 {
     // NBT lists have all items of same kind
     if (array.count == 0) return YES;
-    NBTType type = [self NBTTypeForObject:array.firstObject];
+    NBTType type = NBTTypeOfObject(array.firstObject);
     for (id obj in array) {
-        if ([self NBTTypeForObject:obj] != type) return NO;
-        if (![self isValidNBTObject:obj]) return NO;
+        if (NBTTypeOfObject(obj) != type) return NO;
+        if (![self _isValidObject:obj ofType:type]) return NO;
     }
     return YES;
 }
@@ -266,19 +415,19 @@ NSErrorDomain const NBTKitErrorDomain = @"NBTKitErrorDomain";
 + (BOOL)_isValidCompound:(NSDictionary*)dict
 {
     // NBT compounds have keys as strings, and NBT objects as values
-    if (dict.count == 0) return YES;
-    for (id key in dict.allKeys) {
-        if (![key isKindOfClass:[NSString class]]) return NO;
-    }
-    for (id obj in dict.allValues) {
-        if (![self isValidNBTObject:obj]) return NO;
-    }
-    return YES;
+    __block BOOL valid = YES;
+    [dict enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+        if (NBTTypeOfObject(key) != NBTTypeString || ![self _isValidObject:obj ofType:NBTTypeOfObject(obj)]) {
+            valid = NO;
+            *stop = YES;
+        }
+    }];
+    return valid;
 }
 
-+ (BOOL)isValidNBTObject:(id)obj
++ (BOOL)_isValidObject:(id)obj ofType:(NBTType)type
 {
-    switch ([self NBTTypeForObject:obj]) {
+    switch (type) {
         case NBTTypeByte:
         case NBTTypeShort:
         case NBTTypeInt:
@@ -301,6 +450,16 @@ NSErrorDomain const NBTKitErrorDomain = @"NBTKitErrorDomain";
     }
 }
 
++ (BOOL)isValidNBTObject:(id)obj
+{
+    return [self _isValidObject:obj ofType:[self NBTTypeForObject:obj]];
+}
+
++ (NSError*)_errorFromZlibError:(int)zerr
+{
+    return [NSError errorWithDomain:@"ZLib" code:zerr userInfo:@{@"message": [[NSString alloc] initWithUTF8String:zError(zerr)]}];
+}
+
 + (NSError*)_errorFromException:(NSException*)exception
 {
     if (exception.userInfo[@"error"]) {
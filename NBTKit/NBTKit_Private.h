@@ -10,13 +10,144 @@
 #define NBTKit_NBTKit_Private_h
 
 #import "NBTKit.h"
+#import "NBTReader.h"
+#import "NBTWriter.h"
 #import <Foundation/Foundation.h>
 #import <mach/vm_page_size.h>
+#import <mach/mach_time.h>
+#import <stdatomic.h>
 
 @interface NBTKit (Private)
 + (BOOL)_isValidList:(nullable NSArray*)array;
 + (BOOL)_isValidCompound:(nullable NSDictionary*)dict;
++ (BOOL)_isValidObject:(nullable id)obj ofType:(NBTType)type;
 + (nonnull NSError*)_errorFromException:(nullable NSException*)exception;
++ (nonnull NSError*)_errorFromZlibError:(int)zerr;
++ (nullable NSData*)_inflateData:(nonnull NSData*)zdata error:(NSError *_Nullable *_Nullable)error;
+/// Compresses data in one go, with the compression options of opt (zlib if NBTUseZlib is set, otherwise gzip)
++ (nullable NSData*)_deflateData:(nonnull NSData*)data options:(NBTOptions)opt error:(NSError *_Nullable *_Nullable)error;
+@end
+
+// LZ4 compression of region chunks, in lz4-java's block stream format (see NBTLZ4.m)
+@interface NBTKit (LZ4)
++ (nonnull NSData*)_compressLZ4Data:(nonnull NSData*)data;
++ (nullable NSData*)_decompressLZ4Data:(nonnull NSData*)zdata error:(NSError *_Nullable *_Nullable)error;
+@end
+
+// statistics counters, see NBTStatistics
+typedef NS_ENUM(NSUInteger, NBTStatistic) {
+    NBTStatisticBytesRead,
+    NBTStatisticCompressedBytesRead,
+    NBTStatisticBytesWritten,
+    NBTStatisticCompressedBytesWritten,
+    // times are in mach_absolute_time units
+    NBTStatisticInflateTime,
+    NBTStatisticDeflateTime,
+    NBTStatisticParseTime,
+    NBTStatisticSerializeTime,
+    NBTStatisticAllocations,
+    NBTStatisticRegionHeaderReads,
+    NBTStatisticRegionSeeks,
+    NBTStatisticRegionSectorsAllocated,
+    NBTStatisticRegionSectorsFreed,
+    // sectors of the region file written last, and how many of them are free
+    NBTStatisticRegionSectors,
+    NBTStatisticRegionFreeSectors,
+    // followed by one counter for each tag type
+    NBTStatisticTagsDecoded,
+    NBTStatisticCount = NBTStatisticTagsDecoded + NBTTypeLongArray + 1
+};
+
+extern atomic_bool NBTStatisticsEnabled;
+extern _Atomic(uint64_t) NBTStatisticsCounters[NBTStatisticCount];
+
+NS_INLINE BOOL NBTStatisticsIsEnabled(void) {
+    return __builtin_expect(atomic_load_explicit(&NBTStatisticsEnabled, memory_order_relaxed), 0);
+}
+
+NS_INLINE void NBTStatisticsAdd(NBTStatistic statistic, uint64_t n) {
+    if (NBTStatisticsIsEnabled()) atomic_fetch_add_explicit(&NBTStatisticsCounters[statistic], n, memory_order_relaxed);
+}
+
+NS_INLINE void NBTStatisticsSet(NBTStatistic statistic, uint64_t value) {
+    if (NBTStatisticsIsEnabled()) atomic_store_explicit(&NBTStatisticsCounters[statistic], value, memory_order_relaxed);
+}
+
+NS_INLINE void NBTStatisticsCountTag(NBTType type) {
+    if (NBTStatisticsIsEnabled() && type > NBTTypeEnd && type <= NBTTypeLongArray) {
+        atomic_fetch_add_explicit(&NBTStatisticsCounters[NBTStatisticTagsDecoded + type], 1, memory_order_relaxed);
+    }
+}
+
+/// Returns the start time for NBTStatisticsAddTime, or 0 if statistics are disabled
+NS_INLINE uint64_t NBTStatisticsStart(void) {
+    return NBTStatisticsIsEnabled() ? mach_absolute_time() : 0;
+}
+
+NS_INLINE void NBTStatisticsAddTime(NBTStatistic statistic, uint64_t start) {
+    if (start) atomic_fetch_add_explicit(&NBTStatisticsCounters[statistic], mach_absolute_time() - start, memory_order_relaxed);
+}
+
+// raw chunk access, for nbtdump
+@interface MCRegion (Private)
+/// Opens a region file, without creating it if it doesn't exist and create is NO
+- (nullable instancetype)_initWithFileAtPath:(NSString*)path create:(BOOL)create;
+/// Uncompressed NBT of a chunk, or nil if it isn't present
+- (nullable NSData*)_readChunkData:(NSUInteger)num;
+- (nullable NSDate*)_chunkTimestamp:(NSUInteger)num;
+@end
+
+// chunks are cached by MCRegion, keyed by a number that identifies the region
+@interface MCChunkCache (Private)
+/// Immutable copy of a chunk read from NBT, for caching it
++ (nonnull id)_snapshotOfChunk:(nonnull id)root;
+/// Returns a new mutable copy of a cached chunk, counting a hit or a miss
+- (nullable id)_chunk:(NSUInteger)num ofRegion:(uint64_t)region;
+/// Caches a snapshot of a chunk, cost is the size of its uncompressed NBT
+- (void)_setSnapshot:(nonnull id)snapshot cost:(NSUInteger)cost forChunk:(NSUInteger)num ofRegion:(uint64_t)region;
+- (void)_removeChunk:(NSUInteger)num ofRegion:(uint64_t)region;
+- (void)_removeChunksOfRegion:(uint64_t)region;
+@end
+
+// hashing the uncompressed NBT as it's written, for MCRegion
+@interface NBTWriter ()
+/// Set before writing to compute payloadHash, this keeps the output buffered
+@property (nonatomic, assign) BOOL hashesPayload;
+/// Hash of the uncompressed NBT written last (see NBTHash.h)
+@property (nonatomic, readonly) uint64_t payloadHash;
+@end
+
+// reading primitives, for NBTParser
+@interface NBTReader ()
+- (int8_t)readByte;
+- (int16_t)readShort;
+- (int32_t)readInt;
+- (int64_t)readLong;
+- (float)readFloat;
+- (double)readDouble;
+- (nullable NSString*)readString;
+- (void)read:(nonnull uint8_t*)buf length:(NSUInteger)len;
+- (void)readValues:(nonnull void*)values count:(NSUInteger)count size:(size_t)size;
+- (void)skip:(NSUInteger)len;
+- (void)readError;
+// adds the bytes read and time spent between these calls to NBTStatistics, if enabled
+- (void)beginStatistics;
+- (void)endStatistics;
+@end
+
+// NBT type of an object by its class, NBTTypeInvalid if it doesn't map to one
+extern NBTType NBTTypeOfObject(id _Nullable obj);
+
+// arrays read without copying, as views over the encoded values in the data they were read from
+@interface NBTIntArray (NBTEncodedValues)
+- (nonnull instancetype)_initWithEncodedValues:(nonnull const void *)values count:(NSUInteger)count littleEndian:(BOOL)littleEndian ofData:(nonnull NSData *)data;
+/// Returns the encoded values if they are in the given byte order and haven't been modified, otherwise NULL
+- (nullable const void *)_encodedValuesInByteOrder:(BOOL)littleEndian;
+@end
+
+@interface NBTLongArray (NBTEncodedValues)
+- (nonnull instancetype)_initWithEncodedValues:(nonnull const void *)values count:(NSUInteger)count littleEndian:(BOOL)littleEndian ofData:(nonnull NSData *)data;
+- (nullable const void *)_encodedValuesInByteOrder:(BOOL)littleEndian;
 @end
 
 @interface NSArray (NBTListTypePrivate)
@@ -0,0 +1,228 @@
+//
+//  NBTLZ4.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTKit.h"
+#import "NBTKit_Private.h"
+#import "NBTHash.h"
+
+// LZ4 data in region files is framed like lz4-java's LZ4BlockOutputStream (as used by Minecraft):
+// each block has a 21-byte header with the magic, method and level, compressed and original lengths, and checksum,
+// and the stream ends with an empty block
+#define NBTLZ4Magic             "LZ4Block"
+#define NBTLZ4HeaderLength      21
+#define NBTLZ4BlockSize         (64*1024)
+#define NBTLZ4Level             6 // log2(NBTLZ4BlockSize) - 10
+#define NBTLZ4MethodRaw         0x10
+#define NBTLZ4MethodLZ4         0x20
+#define NBTLZ4ChecksumSeed      0x9747b28c
+
+// LZ4 block format limits
+#define NBTLZ4HashLog           12
+#define NBTLZ4MinMatch          4
+#define NBTLZ4LastLiterals      5
+#define NBTLZ4MatchFindLimit    12
+#define NBTLZ4MaxOffset         65535
+#define NBTLZ4Bound(len)        ((len) + (len) / 255 + 16)
+
+static inline uint32_t NBTLZ4Read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// writes a length that didn't fit in the token, in 255s
+static inline uint8_t *NBTLZ4WriteLength(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// reads a length that didn't fit in the token, returns NO if it runs past the end
+static inline BOOL NBTLZ4ReadLength(const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+    uint8_t b;
+    do {
+        if (*ip >= iend) return NO;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return YES;
+}
+
+// compresses a block with greedy matching, dst must have room for NBTLZ4Bound(len) bytes, returns the compressed length
+static size_t NBTLZ4EncodeBlock(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    uint32_t table[1 << NBTLZ4HashLog] = {0};
+    const uint8_t *ip = src, *anchor = src, *iend = src + len;
+    const uint8_t *matchLimit = iend - NBTLZ4LastLiterals;
+    uint8_t *op = dst;
+    
+    if (len > NBTLZ4MatchFindLimit) {
+        const uint8_t *findLimit = iend - NBTLZ4MatchFindLimit;
+        while (ip < findLimit) {
+            uint32_t sequence = NBTLZ4Read32(ip);
+            uint32_t h = (sequence * 2654435761U) >> (32 - NBTLZ4HashLog);
+            const uint8_t *match = src + table[h];
+            table[h] = (uint32_t)(ip - src);
+            if (match >= ip || ip - match > NBTLZ4MaxOffset || NBTLZ4Read32(match) != sequence) {
+                // skip faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            
+            // extend the match both ways
+            while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+            const uint8_t *end = ip + NBTLZ4MinMatch, *matchEnd = match + NBTLZ4MinMatch;
+            while (end < matchLimit && *end == *matchEnd) {
+                end++;
+                matchEnd++;
+            }
+            
+            // literals, offset and match length
+            size_t literals = ip - anchor, matchLength = end - ip - NBTLZ4MinMatch;
+            uint8_t *token = op++;
+            *token = (uint8_t)(MIN(literals, 15) << 4 | MIN(matchLength, 15));
+            if (literals >= 15) op = NBTLZ4WriteLength(op, literals - 15);
+            memcpy(op, anchor, literals);
+            op += literals;
+            size_t offset = ip - match;
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+            if (matchLength >= 15) op = NBTLZ4WriteLength(op, matchLength - 15);
+            ip = anchor = end;
+        }
+    }
+    
+    // the last literals
+    size_t literals = iend - anchor;
+    *op++ = (uint8_t)(MIN(literals, 15) << 4);
+    if (literals >= 15) op = NBTLZ4WriteLength(op, literals - 15);
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+// decompresses a block into exactly dstLen bytes, returns NO if the data is invalid
+static BOOL NBTLZ4DecodeBlock(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstLen)
+{
+    const uint8_t *ip = src, *iend = src + srcLen;
+    uint8_t *op = dst, *oend = dst + dstLen;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !NBTLZ4ReadLength(&ip, iend, &literals)) return NO;
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) return NO;
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == iend) break; // the last sequence has no match
+        
+        if (iend - ip < 2) return NO;
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !NBTLZ4ReadLength(&ip, iend, &matchLength)) return NO;
+        matchLength += NBTLZ4MinMatch;
+        if (offset == 0 || offset > (size_t)(op - dst) || matchLength > (size_t)(oend - op)) return NO;
+        const uint8_t *match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+        } else {
+            // overlapping, repeats the last offset bytes
+            for (size_t i=0; i < matchLength; i++) op[i] = match[i];
+        }
+        op += matchLength;
+    }
+    return op == oend;
+}
+
+static inline void NBTLZ4WriteHeader(uint8_t *header, uint8_t method, uint32_t compressedLength, uint32_t originalLength, uint32_t checksum)
+{
+    memcpy(header, NBTLZ4Magic, 8);
+    header[8] = method | NBTLZ4Level;
+    OSWriteLittleInt32(header, 9, compressedLength);
+    OSWriteLittleInt32(header, 13, originalLength);
+    OSWriteLittleInt32(header, 17, checksum);
+}
+
+@implementation NBTKit (LZ4)
+
++ (NSData *)_compressLZ4Data:(NSData *)data
+{
+    uint64_t start = NBTStatisticsStart();
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger blocks = (length + NBTLZ4BlockSize - 1) / NBTLZ4BlockSize;
+    NSMutableData *zdata = [NSMutableData dataWithLength:(blocks + 1) * NBTLZ4HeaderLength + NBTLZ4Bound(length)];
+    uint8_t *op = zdata.mutableBytes;
+    
+    for (NSUInteger offset = 0; offset < length; offset += NBTLZ4BlockSize) {
+        uint32_t blockLength = (uint32_t)MIN(length - offset, NBTLZ4BlockSize);
+        uint32_t checksum = NBTHash32(bytes + offset, blockLength, NBTLZ4ChecksumSeed) & 0x0FFFFFFF;
+        uint32_t compressedLength = (uint32_t)NBTLZ4EncodeBlock(bytes + offset, blockLength, op + NBTLZ4HeaderLength);
+        if (compressedLength >= blockLength) {
+            // store it if it doesn't compress
+            memcpy(op + NBTLZ4HeaderLength, bytes + offset, blockLength);
+            NBTLZ4WriteHeader(op, NBTLZ4MethodRaw, blockLength, blockLength, checksum);
+            op += NBTLZ4HeaderLength + blockLength;
+        } else {
+            NBTLZ4WriteHeader(op, NBTLZ4MethodLZ4, compressedLength, blockLength, checksum);
+            op += NBTLZ4HeaderLength + compressedLength;
+        }
+    }
+    NBTLZ4WriteHeader(op, NBTLZ4MethodRaw, 0, 0, 0);
+    op += NBTLZ4HeaderLength;
+    
+    zdata.length = op - (uint8_t*)zdata.mutableBytes;
+    NBTStatisticsAddTime(NBTStatisticDeflateTime, start);
+    NBTStatisticsAdd(NBTStatisticCompressedBytesWritten, zdata.length);
+    return zdata;
+}
+
++ (NSData *)_decompressLZ4Data:(NSData *)zdata error:(NSError *__autoreleasing *)error
+{
+    uint64_t start = NBTStatisticsStart();
+    const uint8_t *ip = zdata.bytes, *iend = ip + zdata.length;
+    NSMutableData *data = [NSMutableData dataWithCapacity:4 * zdata.length];
+    for (;;) {
+        if (iend - ip < NBTLZ4HeaderLength || memcmp(ip, NBTLZ4Magic, 8) != 0) goto invalidData;
+        uint8_t method = ip[8] & 0xF0, level = ip[8] & 0x0F;
+        uint32_t compressedLength = OSReadLittleInt32(ip, 9);
+        uint32_t originalLength = OSReadLittleInt32(ip, 13);
+        uint32_t checksum = OSReadLittleInt32(ip, 17);
+        ip += NBTLZ4HeaderLength;
+        if (originalLength == 0 && compressedLength == 0 && method == NBTLZ4MethodRaw) break; // end of stream
+        if (originalLength > 1U << (level + 10) || compressedLength > (size_t)(iend - ip)) goto invalidData;
+        
+        // decompress at the end of the data
+        NSUInteger offset = data.length;
+        data.length = offset + originalLength;
+        uint8_t *op = (uint8_t*)data.mutableBytes + offset;
+        if (method == NBTLZ4MethodRaw) {
+            if (compressedLength != originalLength) goto invalidData;
+            memcpy(op, ip, originalLength);
+        } else if (method != NBTLZ4MethodLZ4 || !NBTLZ4DecodeBlock(ip, compressedLength, op, originalLength)) {
+            goto invalidData;
+        }
+        if ((NBTHash32(op, originalLength, NBTLZ4ChecksumSeed) & 0x0FFFFFFF) != checksum) goto invalidData;
+        ip += compressedLength;
+    }
+    NBTStatisticsAddTime(NBTStatisticInflateTime, start);
+    NBTStatisticsAdd(NBTStatisticCompressedBytesRead, zdata.length);
+    return data;
+invalidData:
+    if (error) *error = [NSError errorWithDomain:NBTKitErrorDomain code:NBTReadError userInfo:@{NSLocalizedFailureReasonErrorKey: @"Invalid LZ4 data."}];
+    return nil;
+}
+
+@end
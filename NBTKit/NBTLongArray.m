@@ -8,11 +8,18 @@
 
 #import "NBTLongArray.h"
 #import "NBTKit_Private.h"
+#import "NBTByteSwap.h"
 
 @implementation NBTLongArray
 {
     int64_t *storage;
     NSUInteger length, capacity;
+    // encoded values in the data they were read from, until the array is modified
+    NSData *encodedData;
+    const uint8_t *encoded;
+    BOOL encodedSwapped;
+    // values decoded by -values while encoded, they replace the encoded ones when set
+    _Atomic(int64_t*) decoded;
 }
 
 - (instancetype)initWithValues:(const int64_t*)values count:(NSUInteger)count
@@ -56,6 +63,68 @@
     return self;
 }
 
+- (instancetype)_initWithEncodedValues:(const void *)values count:(NSUInteger)count littleEndian:(BOOL)littleEndian ofData:(NSData *)data
+{
+    if ((self = [super init])) {
+        length = count;
+        encodedData = data;
+        encoded = values;
+        encodedSwapped = littleEndian != NBTHostIsLittleEndian;
+    }
+    return self;
+}
+
+- (const void *)_encodedValuesInByteOrder:(BOOL)littleEndian
+{
+    const uint8_t *values = [self _encodedValues];
+    return (values && encodedSwapped == (littleEndian != NBTHostIsLittleEndian)) ? values : NULL;
+}
+
+// decodes the values once, without modifying the encoded ones, so it's safe to call from concurrent readers
+- (int64_t*)_decodedValues
+{
+    int64_t *values = atomic_load_explicit(&decoded, memory_order_acquire);
+    if (values || length == 0) return values;
+    int64_t *newValues = malloc(length * sizeof(int64_t));
+    NBTCopyValues(newValues, encoded, length, sizeof(int64_t), encodedSwapped);
+    if (atomic_compare_exchange_strong_explicit(&decoded, &values, newValues, memory_order_acq_rel, memory_order_acquire)) return newValues;
+    // another thread decoded them first
+    free(newValues);
+    return values;
+}
+
+// moves the decoded values into storage and releases the encoded ones, before the first modification
+- (void)_decodeValues
+{
+    capacity = length;
+    storage = [self _decodedValues];
+    atomic_store_explicit(&decoded, NULL, memory_order_relaxed);
+    encoded = NULL;
+    encodedData = nil;
+}
+
+// the encoded values, or NULL if they have been decoded and may have been modified through -values
+- (const uint8_t *)_encodedValues
+{
+    return encoded && atomic_load_explicit(&decoded, memory_order_acquire) == NULL ? encoded : NULL;
+}
+
+// the decoded values, or NULL if they haven't been decoded
+- (const int64_t *)_plainValues
+{
+    return encoded ? atomic_load_explicit(&decoded, memory_order_acquire) : storage;
+}
+
+- (int64_t)_valueAtIndex:(NSUInteger)idx
+{
+    if (encoded == NULL) return storage[idx];
+    const int64_t *values = atomic_load_explicit(&decoded, memory_order_acquire);
+    if (values) return values[idx];
+    int64_t value;
+    memcpy(&value, encoded + idx * sizeof(int64_t), sizeof(int64_t));
+    return encodedSwapped ? (int64_t)__builtin_bswap64((uint64_t)value) : value;
+}
+
 + (instancetype)longArrayWithValues:(const int64_t *)values count:(NSUInteger)count
 {
     return [[NBTLongArray alloc] initWithValues:values count:count];
@@ -79,6 +148,7 @@
 - (void)dealloc
 {
     free(storage);
+    free(atomic_load_explicit(&decoded, memory_order_relaxed));
 }
 
 - (NSUInteger)count
@@ -88,6 +158,7 @@
 
 - (void)setCount:(NSUInteger)newCount
 {
+    if (encoded) [self _decodeValues];
     if (newCount > length) {
         // embiggen
         [self _ensureAvailableSpaces:newCount];
@@ -101,31 +172,33 @@
 - (void)setValue:(int64_t)value atIndex:(NSUInteger)idx
 {
     if (idx >= length) @throw [NSException exceptionWithName:NSRangeException reason:@"Accessed NBTLongArray out of range" userInfo:nil];
+    if (encoded) [self _decodeValues];
     storage[idx] = value;
 }
 
 - (int64_t)valueAtIndex:(NSUInteger)idx
 {
     if (idx >= length) @throw [NSException exceptionWithName:NSRangeException reason:@"Accessed NBTLongArray out of range" userInfo:nil];
-    return storage[idx];
+    return [self _valueAtIndex:idx];
 }
 
 - (int64_t*)values NS_RETURNS_INNER_POINTER
 {
-    return storage;
+    return encoded ? [self _decodedValues] : storage;
 }
 
 - (NSArray *)array
 {
     id objects[length];
     for (NSUInteger i=0; i < length; i++) {
-        objects[i] = @(storage[i]);
+        objects[i] = @([self _valueAtIndex:i]);
     }
     return [NSArray arrayWithObjects:objects count:length];
 }
 
 - (void)_ensureAvailableSpaces:(NSUInteger)avail
 {
+    if (encoded) [self _decodeValues];
     if (capacity - length < avail) {
         size_t new_size = round_page((length + avail) * sizeof(int64_t));
         // embiggen the array
@@ -150,7 +223,7 @@
 - (void)addLongArray:(NBTLongArray *)array
 {
     [self _ensureAvailableSpaces:array->length];
-    [self addValues:array->storage count:array->length];
+    [self addValues:array.values count:array->length];
 }
 
 - (void)replaceRange:(NSRange)range withValues:(int64_t *)values
@@ -161,6 +234,7 @@
 - (void)replaceRange:(NSRange)range withValues:(int64_t *)values count:(NSUInteger)count
 {
     if (range.location+range.length > length) @throw [NSException exceptionWithName:NSRangeException reason:@"Accessed NBTLongArray out of range" userInfo:nil];
+    if (encoded) [self _decodeValues];
     if (count > range.length) [self _ensureAvailableSpaces:count-range.length];
     if (count != range.length && (length-(range.location+range.length)) > 0) {
         // move end to new position
@@ -183,13 +257,14 @@
     } else {
         NSUInteger count = array->length;
         if (count > range.length) [self _ensureAvailableSpaces:count-range.length];
-        [self replaceRange:range withValues:array->storage count:array->length];
+        [self replaceRange:range withValues:array.values count:array->length];
     }
 }
 
 - (void)resetRange:(NSRange)range
 {
     if (range.location+range.length > length) @throw [NSException exceptionWithName:NSRangeException reason:@"Accessed NBTLongArray out of range" userInfo:nil];
+    if (encoded) [self _decodeValues];
     while (range.length--) storage[range.location++] = 0;
 }
 
@@ -197,7 +272,14 @@
 {
     if (![array isKindOfClass:[NBTLongArray class]]) return NO;
     if (array->length != length) return NO;
-    return memcmp(array->storage, storage, sizeof(int64_t)*length) == 0;
+    const uint8_t *otherEncoded = [array _encodedValues], *selfEncoded = [self _encodedValues];
+    if (otherEncoded && selfEncoded && array->encodedSwapped == encodedSwapped) return memcmp(otherEncoded, selfEncoded, sizeof(int64_t)*length) == 0;
+    const int64_t *otherValues = [array _plainValues], *selfValues = [self _plainValues];
+    if (otherValues && selfValues) return memcmp(otherValues, selfValues, sizeof(int64_t)*length) == 0;
+    for (NSUInteger i=0; i < length; i++) {
+        if ([array _valueAtIndex:i] != [self _valueAtIndex:i]) return NO;
+    }
+    return YES;
 }
 
 - (NSUInteger)hash
@@ -205,14 +287,15 @@
     NSUInteger hash = length;
     for (int i=12; i < sizeof(NSUInteger)/8; i+=4) {
         if (length <= (i-12)/4) break;
-        hash ^= storage[(i-12)/4] << i;
+        hash ^= [self _valueAtIndex:(i-12)/4] << i;
     }
     return hash;
 }
 
 - (id)copyWithZone:(NSZone *)zone
 {
-    return [[NBTLongArray allocWithZone:zone] initWithValues:storage count:length];
+    if ([self _encodedValues]) return [[NBTLongArray allocWithZone:zone] _initWithEncodedValues:encoded count:length littleEndian:encodedSwapped != NBTHostIsLittleEndian ofData:encodedData];
+    return [[NBTLongArray allocWithZone:zone] initWithValues:[self _plainValues] count:length];
 }
 
 - (NSString *)description
@@ -220,7 +303,7 @@
     if (length == 0) return @"<NBTLongArray: ()>";
     NSMutableString *descr = @"<NBTLongArray: (".mutableCopy;
     for (NSUInteger i=0; i < length; i++) {
-        [descr appendFormat:@"%lld,", storage[i]];
+        [descr appendFormat:@"%lld,", [self _valueAtIndex:i]];
     }
     [descr replaceCharactersInRange:NSMakeRange(descr.length-1, 1) withString:@")>"];
     return descr;
@@ -0,0 +1,101 @@
+//
+//  NBTParser.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "NBTKit.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class NBTParser;
+
+/**
+ * The delegate of a NBTParser receives events as tags are read.
+ *
+ * Names are nil for items of lists. All methods are optional.
+ */
+@protocol NBTParserDelegate <NSObject>
+@optional
+
+/// Sent when a compound starts, including the root tag
+- (void)parser:(NBTParser*)parser didStartCompoundWithName:(nullable NSString*)name;
+/// Sent after all the tags in a compound
+- (void)parserDidEndCompound:(NBTParser*)parser;
+
+/// Sent when a list starts, followed by events for count items of the given type
+- (void)parser:(NBTParser*)parser didStartListWithName:(nullable NSString*)name type:(NBTType)type count:(NSUInteger)count;
+/// Sent after all the items in a list
+- (void)parserDidEndList:(NBTParser*)parser;
+
+/// Sent for byte, short, int and long tags
+- (void)parser:(NBTParser*)parser foundInteger:(int64_t)value type:(NBTType)type name:(nullable NSString*)name;
+/// Sent for float and double tags
+- (void)parser:(NBTParser*)parser foundFloat:(double)value type:(NBTType)type name:(nullable NSString*)name;
+/// Sent for string tags
+- (void)parser:(NBTParser*)parser foundString:(NSString*)string name:(nullable NSString*)name;
+
+/// Sent when a byte, int or long array starts
+- (void)parser:(NBTParser*)parser didStartArrayWithName:(nullable NSString*)name type:(NBTType)type count:(NSUInteger)count;
+/**
+ * Sent one or more times with the values of the current array, in host byte order.
+ *
+ * @param values Values of the array's type (int8_t, int32_t or int64_t), only valid until this method returns.
+ * @param count Number of values.
+ */
+- (void)parser:(NBTParser*)parser foundArrayValues:(const void*)values count:(NSUInteger)count;
+/// Sent after all the values of an array
+- (void)parserDidEndArray:(NBTParser*)parser;
+
+@end
+
+/**
+ * @class NBTParser
+ *
+ * Reads NBT data sending events to a delegate, without building a tree of objects.
+ *
+ * Memory use doesn't depend on the size of the data: array values are passed in blocks, and compressed data is inflated as it's read.
+ */
+@interface NBTParser : NSObject
+
+/**
+ * Initializes a parser to read from NBT data.
+ *
+ * @param data The NBT data to read.
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
+ */
+- (instancetype)initWithData:(NSData*)data options:(NBTOptions)opt;
+
+/**
+ * Initializes a parser to read from a stream.
+ *
+ * @param stream Stream to read from.
+ * @param opt A combination of NBTOptions or zero. Valid options for reading are NBTCompressed, NBTLittleEndian and NBTInternStrings
+ */
+- (instancetype)initWithStream:(NSInputStream*)stream options:(NBTOptions)opt;
+
+/// The parser's delegate
+@property (nonatomic, weak, nullable) id<NBTParserDelegate> delegate;
+
+/// Number of compounds and lists containing the current tag, 0 for the root tag
+@property (nonatomic, readonly) NSUInteger depth;
+
+/// The error that stopped parsing, or nil
+@property (nonatomic, readonly, nullable) NSError *parserError;
+
+/**
+ * Reads the root tag, sending events to the delegate.
+ *
+ * @return YES if the whole root tag was read, NO if an error occurred or parsing was aborted.
+ */
+- (BOOL)parse;
+
+/// Stops parsing after the current event, parse returns NO without an error
+- (void)abortParsing;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,208 @@
+//
+//  NBTParser.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTParser.h"
+#import "NBTKit_Private.h"
+#import "NBTReader.h"
+
+// values passed per foundArrayValues: call
+#define NBTParserArrayBlockSize (64*1024)
+
+@implementation NBTParser
+{
+    NBTReader *reader;
+    uint8_t *arrayBuffer;
+    BOOL aborted;
+    // delegate methods implemented
+    struct {
+        BOOL startCompound, endCompound, startList, endList, integer, floatingPoint, string, startArray, arrayValues, endArray;
+    } has;
+}
+
+- (instancetype)initWithData:(NSData *)data options:(NBTOptions)opt
+{
+    if (opt & NBTCompressed) {
+        // inflate as it's read
+        return [self initWithStream:[NSInputStream inputStreamWithData:data] options:opt];
+    }
+    if ((self = [super init])) {
+        reader = [[NBTReader alloc] initWithData:data];
+        reader.littleEndian = opt & NBTLittleEndian;
+        if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    }
+    return self;
+}
+
+- (instancetype)initWithStream:(NSInputStream *)stream options:(NBTOptions)opt
+{
+    if ((self = [super init])) {
+        reader = [[NBTReader alloc] initWithStream:stream compressed:opt & NBTCompressed];
+        reader.littleEndian = opt & NBTLittleEndian;
+        if (opt & NBTInternStrings) reader.internTable = NBTInternTable.sharedTable;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(arrayBuffer);
+}
+
+- (BOOL)parse
+{
+    id<NBTParserDelegate> delegate = self.delegate;
+    has.startCompound = [delegate respondsToSelector:@selector(parser:didStartCompoundWithName:)];
+    has.endCompound = [delegate respondsToSelector:@selector(parserDidEndCompound:)];
+    has.startList = [delegate respondsToSelector:@selector(parser:didStartListWithName:type:count:)];
+    has.endList = [delegate respondsToSelector:@selector(parserDidEndList:)];
+    has.integer = [delegate respondsToSelector:@selector(parser:foundInteger:type:name:)];
+    has.floatingPoint = [delegate respondsToSelector:@selector(parser:foundFloat:type:name:)];
+    has.string = [delegate respondsToSelector:@selector(parser:foundString:name:)];
+    has.startArray = [delegate respondsToSelector:@selector(parser:didStartArrayWithName:type:count:)];
+    has.arrayValues = [delegate respondsToSelector:@selector(parser:foundArrayValues:count:)];
+    has.endArray = [delegate respondsToSelector:@selector(parserDidEndArray:)];
+    aborted = NO;
+    _parserError = nil;
+    _depth = 0;
+    
+    [reader beginStatistics];
+    @try {
+        uint8_t tag = [reader readByte];
+        if (tag == NBTTypeEnd) return YES;
+        NSString *name = [reader readString];
+        [self parseTagOfType:tag name:name delegate:delegate];
+        return YES;
+    }
+    @catch (NSException *exception) {
+        if (aborted) return NO;
+        _parserError = [NBTKit _errorFromException:exception];
+        return NO;
+    }
+    @finally {
+        [reader endStatistics];
+    }
+}
+
+- (void)abortParsing
+{
+    aborted = YES;
+}
+
+- (void)checkAborted
+{
+    if (aborted) @throw [NSException exceptionWithName:@"NBTParserAbort" reason:@"Parsing aborted" userInfo:nil];
+}
+
+- (void)parseTagOfType:(NBTType)type name:(NSString*)name delegate:(id<NBTParserDelegate>)delegate
+{
+    NBTStatisticsCountTag(type);
+    switch (type) {
+        case NBTTypeByte:
+        case NBTTypeShort:
+        case NBTTypeInt:
+        case NBTTypeLong: {
+            int64_t value = type == NBTTypeByte ? [reader readByte] : type == NBTTypeShort ? [reader readShort] : type == NBTTypeInt ? [reader readInt] : [reader readLong];
+            if (has.integer) [delegate parser:self foundInteger:value type:type name:name];
+            break;
+        }
+        case NBTTypeFloat:
+        case NBTTypeDouble: {
+            double value = type == NBTTypeFloat ? [reader readFloat] : [reader readDouble];
+            if (has.floatingPoint) [delegate parser:self foundFloat:value type:type name:name];
+            break;
+        }
+        case NBTTypeString: {
+            NSString *string = [reader readString];
+            if (string == nil) [reader readError];
+            if (has.string) [delegate parser:self foundString:string name:name];
+            break;
+        }
+        case NBTTypeByteArray:
+            [self parseArrayOfType:type size:1 name:name delegate:delegate];
+            break;
+        case NBTTypeIntArray:
+            [self parseArrayOfType:type size:4 name:name delegate:delegate];
+            break;
+        case NBTTypeLongArray:
+            [self parseArrayOfType:type size:8 name:name delegate:delegate];
+            break;
+        case NBTTypeList:
+            [self parseListWithName:name delegate:delegate];
+            break;
+        case NBTTypeCompound:
+            [self parseCompoundWithName:name delegate:delegate];
+            break;
+        default:
+            @throw [NSException exceptionWithName:@"NBTTypeException" reason:[NSString stringWithFormat:@"Don't know how to read tag of type %d", type] userInfo:@{@"tag": @(type)}];
+    }
+    [self checkAborted];
+}
+
+- (void)parseCompoundWithName:(NSString*)name delegate:(id<NBTParserDelegate>)delegate
+{
+    if (has.startCompound) [delegate parser:self didStartCompoundWithName:name];
+    [self checkAborted];
+    _depth++;
+    for (;;) {
+        @autoreleasepool {
+            uint8_t tag = [reader readByte];
+            if (tag == NBTTypeEnd) break;
+            NSString *tagName = [reader readString];
+            [self parseTagOfType:tag name:tagName delegate:delegate];
+        }
+    }
+    _depth--;
+    if (has.endCompound) [delegate parserDidEndCompound:self];
+}
+
+- (void)parseListWithName:(NSString*)name delegate:(id<NBTParserDelegate>)delegate
+{
+    int8_t tag = [reader readByte];
+    int32_t len = [reader readInt];
+    if (len < 0) [reader readError];
+    if (has.startList) [delegate parser:self didStartListWithName:name type:tag count:len];
+    [self checkAborted];
+    _depth++;
+    while (len--) {
+        @autoreleasepool {
+            [self parseTagOfType:tag name:nil delegate:delegate];
+        }
+    }
+    _depth--;
+    if (has.endList) [delegate parserDidEndList:self];
+}
+
+- (void)parseArrayOfType:(NBTType)type size:(size_t)size name:(NSString*)name delegate:(id<NBTParserDelegate>)delegate
+{
+    int32_t len = [reader readInt];
+    if (len < 0) [reader readError];
+    if (has.startArray) [delegate parser:self didStartArrayWithName:name type:type count:len];
+    [self checkAborted];
+    
+    if (!has.arrayValues) {
+        [reader skip:(NSUInteger)len * size];
+    } else {
+        if (arrayBuffer == NULL) arrayBuffer = malloc(NBTParserArrayBlockSize * sizeof(int64_t));
+        NSUInteger left = len;
+        while (left) {
+            NSUInteger count = MIN(left, NBTParserArrayBlockSize);
+            if (size == 1) {
+                [reader read:arrayBuffer length:count];
+            } else {
+                [reader readValues:arrayBuffer count:count size:size];
+            }
+            [delegate parser:self foundArrayValues:arrayBuffer count:count];
+            [self checkAborted];
+            left -= count;
+        }
+    }
+    
+    if (has.endArray) [delegate parserDidEndArray:self];
+}
+
+@end
@@ -8,11 +8,23 @@
 
 #import <Foundation/Foundation.h>
 
+@class NBTInternTable;
+
 @interface NBTReader : NSObject
 
 @property (nonatomic, assign) BOOL littleEndian;
+/// When reading from data, arrays are returned as views over it instead of copies, so it must not be modified while they are in use
+@property (nonatomic, assign) BOOL zeroCopy;
+/// Table of shared strings and numbers to use instead of creating new ones, or nil
+@property (nonatomic, strong) NBTInternTable *internTable;
 
 - (instancetype)initWithStream:(NSInputStream *)stream;
+/// Reads ahead from the stream in large blocks, inflating them if compressed (gzip or zlib)
+- (instancetype)initWithStream:(NSInputStream *)stream compressed:(BOOL)compressed;
+/// Reads directly from the bytes of data, which must not be modified while reading
+- (instancetype)initWithData:(NSData *)data;
 - (id)readRootTag:(NSString **)name error:(NSError **)error;
+/// Reads only the values at the given paths in the root compound, skipping everything else
+- (NSDictionary<NSString*,id> *)readValuesAtPaths:(NSArray<NSString*> *)paths error:(NSError **)error;
 
 @end
@@ -10,17 +10,164 @@
 #import "NBTKit.h"
 #import "NBTKit_Private.h"
 #import "NBTNumbers.h"
+#import "NBTInternTable.h"
+#import "NBTByteSwap.h"
+#import <zlib.h>
+
+#define NBTReaderWindowSize (64*1024)
+
+// node in the tree of requested paths
+@interface NBTPathNode : NSObject
+{
+    @public
+    // UTF-8 name of the path component, and its value as list index (or -1)
+    NSData *name;
+    NSInteger index;
+    // full path if this node was requested
+    NSString *path;
+    NSMutableArray<NBTPathNode*> *children;
+}
+@end
+
+@implementation NBTPathNode
+
+- (NBTPathNode*)childNamed:(NSString*)component
+{
+    NSData *childName = [component dataUsingEncoding:NSUTF8StringEncoding];
+    for (NBTPathNode *child in children) {
+        if ([child->name isEqualToData:childName]) return child;
+    }
+    NBTPathNode *child = [NBTPathNode new];
+    child->name = childName;
+    NSScanner *scanner = [NSScanner scannerWithString:component];
+    NSInteger index;
+    child->index = ([scanner scanInteger:&index] && scanner.atEnd && index >= 0) ? index : -1;
+    if (children == nil) children = [NSMutableArray new];
+    [children addObject:child];
+    return child;
+}
+
+- (NBTPathNode*)childWithName:(const uint8_t*)bytes length:(NSUInteger)len
+{
+    for (NBTPathNode *child in children) {
+        if (child->name.length == len && memcmp(child->name.bytes, bytes, len) == 0) return child;
+    }
+    return nil;
+}
+
+- (NBTPathNode*)childWithIndex:(NSInteger)index
+{
+    for (NBTPathNode *child in children) {
+        if (child->index == index) return child;
+    }
+    return nil;
+}
+
+@end
+
+// byte array over the data it was read from, copied when modified
+@interface NBTByteArrayView : NSMutableData
+- (instancetype)initWithBytes:(const void *)bytes length:(NSUInteger)length ofData:(NSData *)data;
+@end
+
+@implementation NBTByteArrayView
+{
+    NSData *data;
+    const void *bytes;
+    NSUInteger length;
+    NSMutableData *storage;
+}
+
+- (instancetype)initWithBytes:(const void *)someBytes length:(NSUInteger)aLength ofData:(NSData *)aData
+{
+    if ((self = [super init])) {
+        data = aData;
+        bytes = someBytes;
+        length = aLength;
+    }
+    return self;
+}
+
+- (NSMutableData *)storage
+{
+    if (storage == nil) {
+        storage = [NSMutableData dataWithBytes:bytes length:length];
+        data = nil;
+    }
+    return storage;
+}
+
+- (NSUInteger)length
+{
+    return storage ? storage.length : length;
+}
+
+- (const void *)bytes
+{
+    return storage ? storage.bytes : bytes;
+}
+
+- (void *)mutableBytes
+{
+    return self.storage.mutableBytes;
+}
+
+- (void)setLength:(NSUInteger)newLength
+{
+    self.storage.length = newLength;
+}
+
+- (id)mutableCopyWithZone:(NSZone *)zone
+{
+    if (storage) return [storage mutableCopyWithZone:zone];
+    return [[NBTByteArrayView allocWithZone:zone] initWithBytes:bytes length:length ofData:data];
+}
+
+@end
 
 @implementation NBTReader
 {
     NSInputStream *stream;
+    NSData *data;
+    // unread bytes: the whole data, or the current window of the stream
+    const uint8_t *bytes, *end;
+    uint8_t *window;
+    // compressed stream
+    z_stream *zstream;
+    uint8_t *zbuf;
+    int zerr;
+    // statistics: bytes produced by the stream, and state since beginStatistics
+    uint64_t streamOffset;
+    uint64_t statsStart, statsOffset, statsCompressedOffset, inflateTime;
 }
 
 - (instancetype)initWithStream:(NSInputStream *)aStream
+{
+    return [self initWithStream:aStream compressed:NO];
+}
+
+- (instancetype)initWithStream:(NSInputStream *)aStream compressed:(BOOL)compressed
 {
     if ((self = [super init])) {
         stream = aStream;
         [stream open];
+        window = malloc(NBTReaderWindowSize);
+        bytes = end = window;
+        if (compressed) {
+            zbuf = malloc(NBTReaderWindowSize);
+            zstream = calloc(1, sizeof(z_stream));
+            zerr = inflateInit2(zstream, 15 + 32);
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithData:(NSData *)aData
+{
+    if ((self = [super init])) {
+        data = aData;
+        bytes = data.bytes;
+        end = bytes + data.length;
     }
     return self;
 }
@@ -28,10 +175,17 @@
 - (void)dealloc
 {
     [stream close];
+    if (zstream) {
+        inflateEnd(zstream);
+        free(zstream);
+    }
+    free(zbuf);
+    free(window);
 }
 
 - (id)readRootTag:(NSString *__autoreleasing *)name error:(NSError *__autoreleasing *)error
 {
+    [self beginStatistics];
     @try {
         return [self readNamedTag:name];
     }
@@ -39,6 +193,65 @@
         if (error) *error = [NBTKit _errorFromException:exception];
         return nil;
     }
+    @finally {
+        [self endStatistics];
+    }
+}
+
+- (void)beginStatistics
+{
+    statsStart = NBTStatisticsStart();
+    if (statsStart == 0) return;
+    statsOffset = [self offset];
+    statsCompressedOffset = zstream ? zstream->total_in : 0;
+    inflateTime = 0;
+}
+
+- (void)endStatistics
+{
+    if (statsStart == 0) return;
+    uint64_t elapsed = mach_absolute_time() - statsStart;
+    NBTStatisticsAdd(NBTStatisticInflateTime, inflateTime);
+    NBTStatisticsAdd(NBTStatisticParseTime, elapsed - MIN(inflateTime, elapsed));
+    NBTStatisticsAdd(NBTStatisticBytesRead, [self offset] - statsOffset);
+    if (zstream) NBTStatisticsAdd(NBTStatisticCompressedBytesRead, zstream->total_in - statsCompressedOffset);
+    statsStart = 0;
+}
+
+// number of bytes consumed from the data or the (inflated) stream
+- (uint64_t)offset
+{
+    return data ? bytes - (const uint8_t*)data.bytes : streamOffset - (end - bytes);
+}
+
+- (NSDictionary *)readValuesAtPaths:(NSArray<NSString *> *)paths error:(NSError *__autoreleasing *)error
+{
+    // build tree of paths
+    NBTPathNode *root = [NBTPathNode new];
+    for (NSString *path in paths) {
+        NBTPathNode *node = root;
+        for (NSString *component in [path componentsSeparatedByString:@"."]) {
+            node = [node childNamed:component];
+        }
+        node->path = path;
+    }
+    
+    NSMutableDictionary *values = [NSMutableDictionary dictionaryWithCapacity:paths.count];
+    [self beginStatistics];
+    @try {
+        uint8_t tag = [self readByte];
+        if (tag != NBTTypeCompound) [self readError];
+        [self skipString];
+        [self readCompoundAtNode:root values:values count:[NSSet setWithArray:paths].count];
+        return values;
+    }
+    @catch (NSException *exception) {
+        if (error) *error = [NBTKit _errorFromException:exception];
+        return nil;
+    }
+    @finally {
+        [self endStatistics];
+    }
 }
 
 - (id)readNamedTag:(NSString *__autoreleasing *)name
@@ -57,17 +270,26 @@
 
 - (id)readTagOfType:(NBTType)type
 {
+    NBTStatisticsCountTag(type);
     if (type == NBTTypeByte) {
+        if (_internTable) return [_internTable byteWithValue:[self readByte]];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTByte([self readByte]);
     } else if (type == NBTTypeShort) {
+        if (_internTable) return [_internTable shortWithValue:[self readShort]];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTShort([self readShort]);
     } else if (type == NBTTypeInt) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTInt([self readInt]);
     } else if (type == NBTTypeLong) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTLong([self readLong]);
     } else if (type == NBTTypeFloat) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTFloat([self readFloat]);
     } else if (type == NBTTypeDouble) {
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
         return NBTDouble([self readDouble]);
     } else if (type == NBTTypeByteArray) {
         return [self readByteArray];
@@ -93,6 +315,8 @@
     }.mutableCopy;
     if ([stream propertyForKey:NSStreamFileCurrentOffsetKey]) {
         userInfo[NSStreamFileCurrentOffsetKey] = [stream propertyForKey:NSStreamFileCurrentOffsetKey];
+    } else if (data) {
+        userInfo[NSStreamFileCurrentOffsetKey] = @(bytes - (const uint8_t*)data.bytes);
     }
     if (stream.streamError) {
         userInfo[@"error"] = stream.streamError;
@@ -102,32 +326,120 @@
 
 #pragma mark Basic type reading
 
+- (void)zlibError
+{
+    NSError *error = [NBTKit _errorFromZlibError:zerr];
+    @throw [NSException exceptionWithName:@"NBTReadException" reason:error.userInfo[@"message"] userInfo:@{@"error": error}];
+}
+
+// reads up to len bytes from the stream, inflating them if needed
+- (NSInteger)readStream:(uint8_t*)buf maxLength:(NSUInteger)len
+{
+    if (zstream == NULL) {
+        NSInteger br = [stream read:buf maxLength:len];
+        if (br > 0) streamOffset += br;
+        return br;
+    }
+    if (zerr != Z_OK) [self zlibError];
+    
+    zstream->next_out = buf;
+    zstream->avail_out = (uInt)MIN(len, UINT_MAX);
+    uInt maxLength = zstream->avail_out;
+    while (zstream->avail_out == maxLength) {
+        // read more compressed data, inflate reports truncation
+        if (zstream->avail_in == 0) {
+            NSInteger br = [stream read:zbuf maxLength:NBTReaderWindowSize];
+            if (br < 0) return br;
+            zstream->next_in = zbuf;
+            zstream->avail_in = (uInt)br;
+        }
+        
+        uint64_t start = statsStart ? mach_absolute_time() : 0;
+        int err = inflate(zstream, Z_NO_FLUSH);
+        if (start) inflateTime += mach_absolute_time() - start;
+        if (err == Z_STREAM_END) break;
+        if (err != Z_OK) {
+            zerr = err;
+            [self zlibError];
+        }
+    }
+    streamOffset += maxLength - zstream->avail_out;
+    return maxLength - zstream->avail_out;
+}
+
+- (void)read:(uint8_t*)buf length:(NSUInteger)len
+{
+    // available bytes
+    NSUInteger avail = MIN(end - bytes, len);
+    if (avail) memcpy(buf, bytes, avail);
+    bytes += avail;
+    buf += avail;
+    len -= avail;
+    if (len == 0) return;
+    if (data) [self readError];
+    
+    // big reads go straight to the destination
+    while (len >= NBTReaderWindowSize) {
+        NSInteger br = [self readStream:buf maxLength:len];
+        if (br <= 0) [self readError];
+        buf += br;
+        len -= br;
+    }
+    
+    if (len) {
+        [self fill:len];
+        memcpy(buf, bytes, len);
+        bytes += len;
+    }
+}
+
+// makes at least len bytes available at the cursor, reading ahead as much as possible
+- (void)fill:(NSUInteger)len
+{
+    if (data || len > NBTReaderWindowSize) [self readError];
+    
+    // move remaining bytes to the start of the window
+    NSUInteger avail = end - bytes;
+    memmove(window, bytes, avail);
+    bytes = window;
+    end = window + avail;
+    
+    while (avail < len) {
+        NSInteger br = [self readStream:window + avail maxLength:NBTReaderWindowSize - avail];
+        if (br <= 0) [self readError];
+        avail += br;
+        end += br;
+    }
+}
+
 - (int8_t)readByte
 {
-    uint8_t buf[1];
-    if ([stream read:buf maxLength:sizeof buf] != sizeof buf) [self readError];
-    return buf[0];
+    if (bytes == end) [self fill:1];
+    return *bytes++;
 }
 
 - (int16_t)readShort
 {
-    uint8_t buf[2];
-    if ([stream read:buf maxLength:sizeof buf] != sizeof buf) [self readError];
-    return _littleEndian ? OSReadLittleInt16(buf, 0) : OSReadBigInt16(buf, 0);
+    if (end - bytes < 2) [self fill:2];
+    int16_t val = _littleEndian ? OSReadLittleInt16(bytes, 0) : OSReadBigInt16(bytes, 0);
+    bytes += 2;
+    return val;
 }
 
 - (int32_t)readInt
 {
-    uint8_t buf[4];
-    if ([stream read:buf maxLength:sizeof buf] != sizeof buf) [self readError];
-    return _littleEndian ? OSReadLittleInt32(buf, 0) : OSReadBigInt32(buf, 0);
+    if (end - bytes < 4) [self fill:4];
+    int32_t val = _littleEndian ? OSReadLittleInt32(bytes, 0) : OSReadBigInt32(bytes, 0);
+    bytes += 4;
+    return val;
 }
 
 - (int64_t)readLong
 {
-    uint8_t buf[8];
-    if ([stream read:buf maxLength:sizeof buf] != sizeof buf) [self readError];
-    return _littleEndian ? OSReadLittleInt64(buf, 0) : OSReadBigInt64(buf, 0);
+    if (end - bytes < 8) [self fill:8];
+    int64_t val = _littleEndian ? OSReadLittleInt64(bytes, 0) : OSReadBigInt64(bytes, 0);
+    bytes += 8;
+    return val;
 }
 
 - (float)readFloat
@@ -150,11 +462,19 @@
     int32_t len = [self readInt];
     if (len < 0) [self readError];
     
-    // data
-    NSMutableData *data = [NSMutableData dataWithLength:len];
-    if ([stream read:data.mutableBytes maxLength:data.length] != data.length) [self readError];
+    // data, views allocate no buffer
+    if (_zeroCopy && data) {
+        if (end - bytes < len) [self readError];
+        NSMutableData *byteArray = [[NBTByteArrayView alloc] initWithBytes:bytes length:len ofData:data];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+        bytes += len;
+        return byteArray;
+    }
+    NSMutableData *byteArray = [NSMutableData dataWithLength:len];
+    NBTStatisticsAdd(NBTStatisticAllocations, 2);
+    [self read:byteArray.mutableBytes length:len];
     
-    return data;
+    return byteArray;
 }
 
 - (NSString*)readString
@@ -165,10 +485,17 @@
     if (len < 0) [self readError];
     
     // data
-    uint8_t *buf = malloc(len);
-    if ([stream read:buf maxLength:len] != len) [self readError];
+    if (end - bytes < len) [self fill:len];
+    NSString *str;
+    if (_internTable) {
+        str = [_internTable stringWithUTF8Bytes:bytes length:len];
+    } else {
+        str = [[NSString alloc] initWithBytes:bytes length:len encoding:NSUTF8StringEncoding];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+    }
+    bytes += len;
     
-    return [[NSString alloc] initWithBytesNoCopy:buf length:len encoding:NSUTF8StringEncoding freeWhenDone:YES];
+    return str;
 }
 
 - (NSMutableArray*)readList
@@ -182,6 +509,7 @@
     
     // items
     NSMutableArray *list = [NSMutableArray arrayWithCapacity:len];
+    NBTStatisticsAdd(NBTStatisticAllocations, 1);
     while (len--) {
         [list addObject:[self readTagOfType:tag]];
     }
@@ -192,45 +520,203 @@
 
 - (NSMutableDictionary*)readCompound
 {
-    NSMutableDictionary *compound = [NSMutableDictionary new];
-    NSMutableOrderedSet<NSString*> *orderedKeys = [NSMutableOrderedSet orderedSet];
+    NBTCompound *compound = [NBTCompound new];
+    NBTStatisticsAdd(NBTStatisticAllocations, 1);
     
     for (;;) {
         NSString *name = nil;
         id obj = [self readNamedTag:&name];
         if (obj == [NSNull null]) break;
-        [orderedKeys addObject:name];
         compound[name] = obj;
     }
     
-    compound.nbtOrderedKeys = orderedKeys;
     return compound;
 }
 
+// reads count values of size bytes into host byte order
+- (void)readValues:(void*)values count:(NSUInteger)count size:(size_t)size
+{
+    if (count > NSUIntegerMax / size) [self readError];
+    NSUInteger len = count * size;
+    int swap = _littleEndian != NBTHostIsLittleEndian;
+    if (swap && end - bytes >= len) {
+        // convert straight from the buffer
+        NBTCopyValues(values, bytes, count, size, swap);
+        bytes += len;
+        return;
+    }
+    [self read:values length:len];
+    NBTCopyValues(values, values, count, size, swap);
+}
+
 - (NBTIntArray*)readIntArray
 {
     int32_t len = [self readInt];
-    if (len < 0) [self readError];
-    NBTIntArray *intArray = [NBTIntArray intArrayWithCount:len];
-    int32_t *values = intArray.values;
-    while (len--) {
-        *values++ = [self readInt];
+    if (len < 0 || (data && end - bytes < (NSUInteger)len * sizeof(int32_t))) [self readError];
+    if (_zeroCopy && data && len > 0) {
+        NBTIntArray *intArray = [[NBTIntArray alloc] _initWithEncodedValues:bytes count:len littleEndian:_littleEndian ofData:data];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+        bytes += (NSUInteger)len * sizeof(int32_t);
+        return intArray;
     }
-    
+    NBTIntArray *intArray = [NBTIntArray intArrayWithCount:len];
+    [self readValues:intArray.values count:len size:sizeof(int32_t)];
+    NBTStatisticsAdd(NBTStatisticAllocations, 2);
     return intArray;
 }
 
 - (NBTLongArray*)readLongArray
 {
     int32_t len = [self readInt];
-    if (len < 0) [self readError];
-    NBTLongArray *longArray = [NBTLongArray longArrayWithCount:len];
-    int64_t *values = longArray.values;
-    while (len--) {
-        *values++ = [self readLong];
+    if (len < 0 || (data && end - bytes < (NSUInteger)len * sizeof(int64_t))) [self readError];
+    if (_zeroCopy && data && len > 0) {
+        NBTLongArray *longArray = [[NBTLongArray alloc] _initWithEncodedValues:bytes count:len littleEndian:_littleEndian ofData:data];
+        NBTStatisticsAdd(NBTStatisticAllocations, 1);
+        bytes += (NSUInteger)len * sizeof(int64_t);
+        return longArray;
     }
-    
+    NBTLongArray *longArray = [NBTLongArray longArrayWithCount:len];
+    [self readValues:longArray.values count:len size:sizeof(int64_t)];
+    NBTStatisticsAdd(NBTStatisticAllocations, 2);
     return longArray;
 }
 
+#pragma mark - Path reading
+
+// reads the values at the paths under node, returns YES once all paths have been found
+- (BOOL)readCompoundAtNode:(NBTPathNode*)node values:(NSMutableDictionary*)values count:(NSUInteger)count
+{
+    for (;;) {
+        uint8_t tag = [self readByte];
+        if (tag == NBTTypeEnd) return NO;
+        int16_t len = [self readShort];
+        if (len < 0) [self readError];
+        if (end - bytes < len) [self fill:len];
+        NBTPathNode *child = [node childWithName:bytes length:len];
+        bytes += len;
+        if ([self readTagOfType:tag atNode:child values:values count:count]) return YES;
+    }
+}
+
+- (BOOL)readListAtNode:(NBTPathNode*)node values:(NSMutableDictionary*)values count:(NSUInteger)count
+{
+    int8_t tag = [self readByte];
+    int32_t len = [self readInt];
+    if (len < 0) [self readError];
+    for (NSInteger i=0; i < len; i++) {
+        if ([self readTagOfType:tag atNode:[node childWithIndex:i] values:values count:count]) return YES;
+    }
+    return NO;
+}
+
+- (BOOL)readTagOfType:(NBTType)tag atNode:(NBTPathNode*)node values:(NSMutableDictionary*)values count:(NSUInteger)count
+{
+    if (node == nil) {
+        [self skipTagOfType:tag];
+        return NO;
+    } else if (node->path) {
+        id value = [self readTagOfType:tag];
+        values[node->path] = value;
+        [self addValuesAtNode:node fromObject:value values:values];
+    } else if (tag == NBTTypeCompound) {
+        return [self readCompoundAtNode:node values:values count:count];
+    } else if (tag == NBTTypeList) {
+        return [self readListAtNode:node values:values count:count];
+    } else {
+        [self skipTagOfType:tag];
+    }
+    return values.count == count;
+}
+
+// adds values for paths under an already read object
+- (void)addValuesAtNode:(NBTPathNode*)node fromObject:(id)obj values:(NSMutableDictionary*)values
+{
+    for (NBTPathNode *child in node->children) {
+        id value = nil;
+        if ([obj isKindOfClass:[NSDictionary class]]) {
+            value = obj[[[NSString alloc] initWithData:child->name encoding:NSUTF8StringEncoding]];
+        } else if ([obj isKindOfClass:[NSArray class]] && child->index >= 0 && child->index < [obj count]) {
+            value = obj[child->index];
+        }
+        if (value == nil) continue;
+        if (child->path) values[child->path] = value;
+        [self addValuesAtNode:child fromObject:value values:values];
+    }
+}
+
+#pragma mark - Skipping
+
+- (void)skip:(NSUInteger)len
+{
+    for (;;) {
+        NSUInteger avail = MIN(end - bytes, len);
+        bytes += avail;
+        len -= avail;
+        if (len == 0) return;
+        [self fill:MIN(len, NBTReaderWindowSize)];
+    }
+}
+
+- (void)skipString
+{
+    int16_t len = [self readShort];
+    if (len < 0) [self readError];
+    [self skip:len];
+}
+
+- (void)skipArrayOfSize:(NSUInteger)size
+{
+    int32_t len = [self readInt];
+    if (len < 0) [self readError];
+    [self skip:(NSUInteger)len * size];
+}
+
+// size of a value of a fixed size type, or 0
+static NSUInteger NBTFixedSizeOfType(NBTType type)
+{
+    switch (type) {
+        case NBTTypeByte: return 1;
+        case NBTTypeShort: return 2;
+        case NBTTypeInt:
+        case NBTTypeFloat: return 4;
+        case NBTTypeLong:
+        case NBTTypeDouble: return 8;
+        default: return 0;
+    }
+}
+
+- (void)skipTagOfType:(NBTType)type
+{
+    NSUInteger size = NBTFixedSizeOfType(type);
+    if (size) {
+        [self skip:size];
+    } else if (type == NBTTypeByteArray) {
+        [self skipArrayOfSize:1];
+    } else if (type == NBTTypeString) {
+        [self skipString];
+    } else if (type == NBTTypeList) {
+        int8_t tag = [self readByte];
+        int32_t len = [self readInt];
+        if (len < 0) [self readError];
+        size = NBTFixedSizeOfType(tag);
+        if (size) {
+            [self skip:(NSUInteger)len * size];
+        } else {
+            while (len--) [self skipTagOfType:tag];
+        }
+    } else if (type == NBTTypeCompound) {
+        uint8_t tag;
+        while ((tag = [self readByte]) != NBTTypeEnd) {
+            [self skipString];
+            [self skipTagOfType:tag];
+        }
+    } else if (type == NBTTypeIntArray) {
+        [self skipArrayOfSize:4];
+    } else if (type == NBTTypeLongArray) {
+        [self skipArrayOfSize:8];
+    } else {
+        @throw [NSException exceptionWithName:@"NBTTypeException" reason:[NSString stringWithFormat:@"Don't know how to read tag of type %d", type] userInfo:@{@"tag": @(type)}];
+    }
+}
+
 @end
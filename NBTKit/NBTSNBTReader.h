@@ -0,0 +1,24 @@
+//
+//  NBTSNBTReader.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class NBTInternTable;
+
+/// Parses SNBT (stringified NBT, as used in Minecraft commands) straight into NBTKit objects
+@interface NBTSNBTReader : NSObject
+
+/// Table of shared strings and numbers to use instead of creating new ones, or nil
+@property (nonatomic, strong) NBTInternTable *internTable;
+
+/// Reads from the UTF-8 text in data
+- (instancetype)initWithData:(NSData *)data;
+/// Reads a value, which must be followed only by whitespace
+- (id)readValue:(NSError **)error;
+
+@end
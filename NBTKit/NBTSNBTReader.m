@@ -0,0 +1,380 @@
+//
+//  NBTSNBTReader.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTSNBTReader.h"
+#import "NBTKit.h"
+#import "NBTKit_Private.h"
+
+// same limit as Minecraft
+#define NBTSNBTMaxDepth 512
+
+static inline BOOL NBTIsSNBTUnquotedChar(uint8_t c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '-' || c == '.' || c == '+';
+}
+
+static inline BOOL NBTIsDigit(uint8_t c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// parses a decimal integer within [min, max]
+static BOOL NBTParseSNBTInteger(const uint8_t *t, NSUInteger len, int64_t min, int64_t max, int64_t *value)
+{
+    NSUInteger i = 0;
+    BOOL negative = NO;
+    if (len && (t[0] == '-' || t[0] == '+')) negative = t[i++] == '-';
+    if (i == len) return NO;
+    uint64_t v = 0;
+    for (; i < len; i++) {
+        if (!NBTIsDigit(t[i])) return NO;
+        unsigned digit = t[i] - '0';
+        if (v > (UINT64_MAX - digit) / 10) return NO;
+        v = v * 10 + digit;
+    }
+    if (negative) {
+        if (v > (uint64_t)-(min + 1) + 1) return NO;
+        *value = (int64_t)(0 - v);
+    } else {
+        if (v > (uint64_t)max) return NO;
+        *value = (int64_t)v;
+    }
+    return YES;
+}
+
+// checks for a decimal number with an optional fraction and exponent
+static BOOL NBTIsSNBTDecimal(const uint8_t *t, NSUInteger len)
+{
+    NSUInteger i = 0, digits = 0;
+    if (i < len && (t[i] == '-' || t[i] == '+')) i++;
+    for (; i < len && NBTIsDigit(t[i]); i++) digits++;
+    if (i < len && t[i] == '.') {
+        for (i++; i < len && NBTIsDigit(t[i]); i++) digits++;
+    }
+    if (digits == 0) return NO;
+    if (i < len && (t[i] | 0x20) == 'e') {
+        NSUInteger exponentDigits = 0;
+        i++;
+        if (i < len && (t[i] == '-' || t[i] == '+')) i++;
+        for (; i < len && NBTIsDigit(t[i]); i++) exponentDigits++;
+        if (exponentDigits == 0) return NO;
+    }
+    return i == len;
+}
+
+static inline BOOL NBTTokenEquals(const uint8_t *t, NSUInteger len, const char *str)
+{
+    return strlen(str) == len && memcmp(t, str, len) == 0;
+}
+
+@implementation NBTSNBTReader
+{
+    NSData *data;
+    const uint8_t *start, *bytes, *end;
+    NSUInteger depth;
+    // unescaped strings and numbers for strtod
+    uint8_t *scratch;
+    NSUInteger scratchLength, scratchCapacity;
+}
+
+- (instancetype)initWithData:(NSData *)aData
+{
+    if ((self = [super init])) {
+        data = aData;
+        start = bytes = data.bytes;
+        end = bytes + data.length;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(scratch);
+}
+
+- (id)readValue:(NSError *__autoreleasing *)error
+{
+    uint64_t statsStart = NBTStatisticsStart();
+    @try {
+        // skip UTF-8 BOM
+        if (end - bytes >= 3 && memcmp(bytes, "\xEF\xBB\xBF", 3) == 0) bytes += 3;
+        id value = [self readTag];
+        [self skipWhitespace];
+        if (bytes != end) [self syntaxError:@"Unexpected data after value"];
+        return value;
+    }
+    @catch (NSException *exception) {
+        if (error) *error = [NBTKit _errorFromException:exception];
+        return nil;
+    }
+    @finally {
+        NBTStatisticsAddTime(NBTStatisticParseTime, statsStart);
+        NBTStatisticsAdd(NBTStatisticBytesRead, bytes - start);
+    }
+}
+
+- (void)syntaxError:(NSString *)reason
+{
+    NSDictionary *userInfo = @{
+        NSLocalizedFailureReasonErrorKey: reason,
+        NSStreamFileCurrentOffsetKey: @(bytes - start)
+    };
+    @throw [NSException exceptionWithName:@"NBTReadException" reason:reason userInfo:userInfo];
+}
+
+#pragma mark - Tokens
+
+- (void)skipWhitespace
+{
+    while (bytes < end && (*bytes == ' ' || *bytes == '\n' || *bytes == '\t' || *bytes == '\r')) bytes++;
+}
+
+// skips whitespace and the given character if it's next
+- (BOOL)consume:(uint8_t)c
+{
+    [self skipWhitespace];
+    if (bytes < end && *bytes == c) {
+        bytes++;
+        return YES;
+    }
+    return NO;
+}
+
+- (void)expect:(uint8_t)c
+{
+    if (![self consume:c]) [self syntaxError:[NSString stringWithFormat:@"Expected '%c'", c]];
+}
+
+- (NSString *)stringWithBytes:(const uint8_t *)someBytes length:(NSUInteger)length
+{
+    NSString *string = _internTable ? [_internTable stringWithUTF8Bytes:someBytes length:length] : [[NSString alloc] initWithBytes:someBytes length:length encoding:NSUTF8StringEncoding];
+    if (string == nil) [self syntaxError:@"Invalid UTF-8 string"];
+    return string;
+}
+
+- (void)appendScratch:(const uint8_t *)someBytes length:(NSUInteger)length
+{
+    if (scratchCapacity - scratchLength < length) {
+        scratchCapacity = MAX(2 * scratchCapacity, MAX(scratchLength + length, 256));
+        scratch = realloc(scratch, scratchCapacity);
+    }
+    memcpy(scratch + scratchLength, someBytes, length);
+    scratchLength += length;
+}
+
+- (NSString *)readQuotedString
+{
+    uint8_t quote = *bytes++;
+    const uint8_t *run = bytes;
+    while (bytes < end && *bytes != quote && *bytes != '\\') bytes++;
+    if (bytes == end) [self syntaxError:@"Unterminated string"];
+    if (*bytes == quote) {
+        // no escapes, straight from the data
+        NSString *string = [self stringWithBytes:run length:bytes - run];
+        bytes++;
+        return string;
+    }
+    
+    // unescape into the scratch buffer
+    scratchLength = 0;
+    for (;;) {
+        [self appendScratch:run length:bytes - run];
+        if (bytes == end) [self syntaxError:@"Unterminated string"];
+        if (*bytes++ == quote) break;
+        if (bytes == end) [self syntaxError:@"Unterminated string"];
+        uint8_t c = *bytes++;
+        if (c == 'n') c = '\n';
+        else if (c == 't') c = '\t';
+        else if (c == 'r') c = '\r';
+        else if (c != '\\' && c != '"' && c != '\'') [self syntaxError:@"Invalid escape sequence"];
+        [self appendScratch:&c length:1];
+        run = bytes;
+        while (bytes < end && *bytes != quote && *bytes != '\\') bytes++;
+    }
+    return [self stringWithBytes:scratch length:scratchLength];
+}
+
+// returns the length of the unquoted token at bytes
+- (NSUInteger)unquotedLength
+{
+    const uint8_t *t = bytes;
+    while (t < end && NBTIsSNBTUnquotedChar(*t)) t++;
+    return t - bytes;
+}
+
+#pragma mark - Values
+
+- (id)readTag
+{
+    [self skipWhitespace];
+    if (bytes == end) [self syntaxError:@"Expected value"];
+    switch (*bytes) {
+        case '{':
+            return [self readCompound];
+        case '[':
+            return [self readList];
+        case '"':
+        case '\'':
+            return [self readQuotedString];
+        default:
+            return [self readUnquotedValue];
+    }
+}
+
+- (void)enter
+{
+    if (++depth > NBTSNBTMaxDepth) [self syntaxError:@"Too deeply nested"];
+}
+
+- (NSMutableDictionary *)readCompound
+{
+    bytes++;
+    [self enter];
+    NBTCompound *compound = [NBTCompound new];
+    if ([self consume:'}']) {
+        depth--;
+        return compound;
+    }
+    do {
+        // key
+        NSString *key;
+        [self skipWhitespace];
+        if (bytes < end && (*bytes == '"' || *bytes == '\'')) {
+            key = [self readQuotedString];
+        } else {
+            NSUInteger len = [self unquotedLength];
+            if (len == 0) [self syntaxError:@"Expected key"];
+            key = [self stringWithBytes:bytes length:len];
+            bytes += len;
+        }
+        [self expect:':'];
+        compound[key] = [self readTag];
+    } while ([self consume:',']);
+    [self expect:'}'];
+    depth--;
+    return compound;
+}
+
+- (id)readList
+{
+    bytes++;
+    [self skipWhitespace];
+    if (end - bytes >= 2 && bytes[1] == ';') {
+        if (bytes[0] == 'B') return [self readArrayOfType:NBTTypeByteArray];
+        if (bytes[0] == 'I') return [self readArrayOfType:NBTTypeIntArray];
+        if (bytes[0] == 'L') return [self readArrayOfType:NBTTypeLongArray];
+        [self syntaxError:@"Invalid array type"];
+    }
+    
+    [self enter];
+    NSMutableArray *list = [NSMutableArray array];
+    if ([self consume:']']) {
+        depth--;
+        return list;
+    }
+    NBTType listType = NBTTypeInvalid;
+    do {
+        id item = [self readTag];
+        NBTType type = NBTTypeOfObject(item);
+        if (list.count == 0) {
+            listType = type;
+        } else if (type != listType) {
+            [self syntaxError:@"List items must be of the same type"];
+        }
+        [list addObject:item];
+    } while ([self consume:',']);
+    [self expect:']'];
+    list.nbtListType = listType;
+    depth--;
+    return list;
+}
+
+- (id)readArrayOfType:(NBTType)type
+{
+    bytes += 2;
+    int64_t min = type == NBTTypeByteArray ? INT8_MIN : type == NBTTypeIntArray ? INT32_MIN : INT64_MIN;
+    int64_t max = type == NBTTypeByteArray ? INT8_MAX : type == NBTTypeIntArray ? INT32_MAX : INT64_MAX;
+    uint8_t suffix = type == NBTTypeByteArray ? 'b' : type == NBTTypeLongArray ? 'l' : 0;
+    NSMutableData *byteArray = type == NBTTypeByteArray ? [NSMutableData data] : nil;
+    NBTIntArray *intArray = type == NBTTypeIntArray ? [NBTIntArray intArrayWithCapacity:16] : nil;
+    NBTLongArray *longArray = type == NBTTypeLongArray ? [NBTLongArray longArrayWithCapacity:16] : nil;
+    id array = byteArray ?: intArray ?: longArray;
+    if ([self consume:']']) return array;
+    
+    do {
+        [self skipWhitespace];
+        NSUInteger len = [self unquotedLength];
+        const uint8_t *t = bytes;
+        // the type's suffix is optional
+        if (len > 1 && suffix && (t[len - 1] | 0x20) == suffix) len--;
+        int64_t value = 0;
+        if (!NBTParseSNBTInteger(t, len, min, max, &value)) {
+            if (type == NBTTypeByteArray && NBTTokenEquals(t, len, "true")) value = 1;
+            else if (type == NBTTypeByteArray && NBTTokenEquals(t, len, "false")) value = 0;
+            else [self syntaxError:@"Invalid array value"];
+        }
+        bytes += [self unquotedLength];
+        if (byteArray) {
+            int8_t byte = (int8_t)value;
+            [byteArray appendBytes:&byte length:1];
+        } else if (intArray) {
+            [intArray addValue:(int32_t)value];
+        } else {
+            [longArray addValue:value];
+        }
+    } while ([self consume:',']);
+    [self expect:']'];
+    return array;
+}
+
+- (id)readUnquotedValue
+{
+    NSUInteger len = [self unquotedLength];
+    if (len == 0) [self syntaxError:[NSString stringWithFormat:@"Unexpected character '%c'", *bytes]];
+    const uint8_t *t = bytes;
+    bytes += len;
+    
+    // integers, with the type's suffix
+    int64_t value;
+    uint8_t suffix = t[len - 1] | 0x20;
+    if (suffix == 'b' && NBTParseSNBTInteger(t, len - 1, INT8_MIN, INT8_MAX, &value)) {
+        return _internTable ? [_internTable byteWithValue:(int8_t)value] : NBTByte((int8_t)value);
+    } else if (suffix == 's' && NBTParseSNBTInteger(t, len - 1, INT16_MIN, INT16_MAX, &value)) {
+        return _internTable ? [_internTable shortWithValue:(int16_t)value] : NBTShort((int16_t)value);
+    } else if (suffix == 'l' && NBTParseSNBTInteger(t, len - 1, INT64_MIN, INT64_MAX, &value)) {
+        return NBTLong(value);
+    } else if (NBTIsDigit(suffix) && NBTParseSNBTInteger(t, len, INT32_MIN, INT32_MAX, &value)) {
+        return NBTInt((int32_t)value);
+    }
+    
+    // floating point, doubles don't need a suffix
+    BOOL isFloat = suffix == 'f';
+    NSUInteger numberLength = (isFloat || suffix == 'd') ? len - 1 : len;
+    if (NBTIsSNBTDecimal(t, numberLength) && (numberLength < len || memchr(t, '.', len) || memchr(t, 'e', len) || memchr(t, 'E', len))) {
+        scratchLength = 0;
+        [self appendScratch:t length:numberLength];
+        [self appendScratch:(const uint8_t *)"" length:1];
+        return isFloat ? NBTFloat(strtof((const char *)scratch, NULL)) : NBTDouble(strtod((const char *)scratch, NULL));
+    } else if (isFloat || suffix == 'd') {
+        // not representable in SNBT, but written by Minecraft
+        const uint8_t *n = t;
+        double special = 0;
+        if (NBTTokenEquals(n, numberLength, "NaN")) special = NAN;
+        else if (NBTTokenEquals(n, numberLength, "Infinity")) special = INFINITY;
+        else if (NBTTokenEquals(n, numberLength, "-Infinity")) special = -INFINITY;
+        if (special != 0) return isFloat ? NBTFloat((float)special) : NBTDouble(special);
+    }
+    
+    if (NBTTokenEquals(t, len, "true")) return _internTable ? [_internTable byteWithValue:1] : NBTByte(1);
+    if (NBTTokenEquals(t, len, "false")) return _internTable ? [_internTable byteWithValue:0] : NBTByte(0);
+    
+    // anything else is a string
+    return [self stringWithBytes:t length:len];
+}
+
+@end
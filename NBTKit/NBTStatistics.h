@@ -0,0 +1,74 @@
+//
+//  NBTStatistics.h
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "NBTKit.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @class NBTStatistics
+ *
+ * Counters and timings collected by NBTKit while reading and writing NBT and region files, for finding out where time is spent.
+ *
+ * Collection is disabled by default, and costs a single check at each counting point while disabled.
+ * Counters are shared by all threads, and keep adding up until they are reset.
+ */
+@interface NBTStatistics : NSObject <NSCopying>
+
+/// Enables or disables collecting statistics
+@property (class, nonatomic, getter=isEnabled) BOOL enabled;
+
+/// Returns the current value of the counters
++ (NBTStatistics *)snapshot;
+
+/// Sets all counters to zero
++ (void)reset;
+
+/// Uncompressed NBT bytes read
+@property (nonatomic, readonly) uint64_t bytesRead;
+/// Compressed bytes read, for compressed data
+@property (nonatomic, readonly) uint64_t compressedBytesRead;
+/// Uncompressed NBT bytes written
+@property (nonatomic, readonly) uint64_t bytesWritten;
+/// Compressed bytes written, for compressed data
+@property (nonatomic, readonly) uint64_t compressedBytesWritten;
+
+/// Time spent inflating compressed data
+@property (nonatomic, readonly) NSTimeInterval inflateTime;
+/// Time spent deflating data
+@property (nonatomic, readonly) NSTimeInterval deflateTime;
+/// Time spent decoding NBT, excluding inflating
+@property (nonatomic, readonly) NSTimeInterval parseTime;
+/// Time spent encoding NBT, excluding deflating
+@property (nonatomic, readonly) NSTimeInterval serializeTime;
+
+/// Total number of tags decoded
+@property (nonatomic, readonly) uint64_t tagsDecoded;
+/// Returns the number of tags of a type decoded
+- (uint64_t)tagsDecodedOfType:(NBTType)type;
+/// Objects and buffers allocated while reading and writing, not counting shared numbers and interned strings that are reused
+@property (nonatomic, readonly) uint64_t allocations;
+
+/// Region file headers read
+@property (nonatomic, readonly) uint64_t regionHeaderReads;
+/// Positioned reads and writes to region files
+@property (nonatomic, readonly) uint64_t regionSeeks;
+/// Sectors allocated for chunks in region files
+@property (nonatomic, readonly) uint64_t regionSectorsAllocated;
+/// Sectors freed in region files
+@property (nonatomic, readonly) uint64_t regionSectorsFreed;
+/// Fraction of unused sectors in the last region file written (0 to 1)
+@property (nonatomic, readonly) double regionFragmentation;
+
+/// The statistics as a dictionary, with times in seconds
+@property (nonatomic, readonly) NSDictionary<NSString*, NSNumber*> *dictionaryRepresentation;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,128 @@
+//
+//  NBTStatistics.m
+//  NBTKit
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import "NBTStatistics.h"
+#import "NBTKit_Private.h"
+
+atomic_bool NBTStatisticsEnabled;
+_Atomic(uint64_t) NBTStatisticsCounters[NBTStatisticCount];
+
+@implementation NBTStatistics
+{
+    uint64_t counters[NBTStatisticCount];
+}
+
++ (BOOL)isEnabled
+{
+    return atomic_load(&NBTStatisticsEnabled);
+}
+
++ (void)setEnabled:(BOOL)enabled
+{
+    atomic_store(&NBTStatisticsEnabled, enabled);
+}
+
++ (NBTStatistics *)snapshot
+{
+    NBTStatistics *snapshot = [NBTStatistics new];
+    for (NSUInteger i=0; i < NBTStatisticCount; i++) {
+        snapshot->counters[i] = atomic_load_explicit(&NBTStatisticsCounters[i], memory_order_relaxed);
+    }
+    return snapshot;
+}
+
++ (void)reset
+{
+    for (NSUInteger i=0; i < NBTStatisticCount; i++) {
+        atomic_store_explicit(&NBTStatisticsCounters[i], 0, memory_order_relaxed);
+    }
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+static NSTimeInterval NBTStatisticsSeconds(uint64_t t)
+{
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return (double)t * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+- (uint64_t)bytesRead { return counters[NBTStatisticBytesRead]; }
+- (uint64_t)compressedBytesRead { return counters[NBTStatisticCompressedBytesRead]; }
+- (uint64_t)bytesWritten { return counters[NBTStatisticBytesWritten]; }
+- (uint64_t)compressedBytesWritten { return counters[NBTStatisticCompressedBytesWritten]; }
+- (NSTimeInterval)inflateTime { return NBTStatisticsSeconds(counters[NBTStatisticInflateTime]); }
+- (NSTimeInterval)deflateTime { return NBTStatisticsSeconds(counters[NBTStatisticDeflateTime]); }
+- (NSTimeInterval)parseTime { return NBTStatisticsSeconds(counters[NBTStatisticParseTime]); }
+- (NSTimeInterval)serializeTime { return NBTStatisticsSeconds(counters[NBTStatisticSerializeTime]); }
+- (uint64_t)allocations { return counters[NBTStatisticAllocations]; }
+- (uint64_t)regionHeaderReads { return counters[NBTStatisticRegionHeaderReads]; }
+- (uint64_t)regionSeeks { return counters[NBTStatisticRegionSeeks]; }
+- (uint64_t)regionSectorsAllocated { return counters[NBTStatisticRegionSectorsAllocated]; }
+- (uint64_t)regionSectorsFreed { return counters[NBTStatisticRegionSectorsFreed]; }
+
+- (double)regionFragmentation
+{
+    uint64_t sectors = counters[NBTStatisticRegionSectors];
+    return sectors ? (double)counters[NBTStatisticRegionFreeSectors] / sectors : 0.0;
+}
+
+- (uint64_t)tagsDecodedOfType:(NBTType)type
+{
+    if (type <= NBTTypeEnd || type > NBTTypeLongArray) return 0;
+    return counters[NBTStatisticTagsDecoded + type];
+}
+
+- (uint64_t)tagsDecoded
+{
+    uint64_t total = 0;
+    for (NBTType type = NBTTypeByte; type <= NBTTypeLongArray; type++) {
+        total += counters[NBTStatisticTagsDecoded + type];
+    }
+    return total;
+}
+
+- (NSDictionary<NSString *,NSNumber *> *)dictionaryRepresentation
+{
+    NSMutableDictionary *dict = @{
+        @"bytesRead": @(self.bytesRead),
+        @"compressedBytesRead": @(self.compressedBytesRead),
+        @"bytesWritten": @(self.bytesWritten),
+        @"compressedBytesWritten": @(self.compressedBytesWritten),
+        @"inflateTime": @(self.inflateTime),
+        @"deflateTime": @(self.deflateTime),
+        @"parseTime": @(self.parseTime),
+        @"serializeTime": @(self.serializeTime),
+        @"tagsDecoded": @(self.tagsDecoded),
+        @"allocations": @(self.allocations),
+        @"regionHeaderReads": @(self.regionHeaderReads),
+        @"regionSeeks": @(self.regionSeeks),
+        @"regionSectorsAllocated": @(self.regionSectorsAllocated),
+        @"regionSectorsFreed": @(self.regionSectorsFreed),
+        @"regionFragmentation": @(self.regionFragmentation),
+    }.mutableCopy;
+    for (NBTType type = NBTTypeByte; type <= NBTTypeLongArray; type++) {
+        dict[[NSString stringWithFormat:@"tagsDecoded.%@", [NBTKit nameOfNBTType:type]]] = @([self tagsDecodedOfType:type]);
+    }
+    return dict;
+}
+
+- (NSString *)description
+{
+    NSDictionary *dict = self.dictionaryRepresentation;
+    NSMutableString *description = [NSMutableString stringWithFormat:@"<%@ %p>", NSStringFromClass([self class]), self];
+    for (NSString *key in [dict.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        [description appendFormat:@"\n  %@: %@", key, dict[key]];
+    }
+    return description;
+}
+
+@end
@@ -7,12 +7,22 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "NBTKit.h"
 
 @interface NBTWriter : NSObject
 
 @property (nonatomic, assign) BOOL littleEndian;
 
+/// Output is buffered and written to the stream in large blocks
 - (instancetype)initWithStream:(NSOutputStream *)stream;
+/// Output is appended to data, which is left unchanged if writing fails
+- (instancetype)initWithData:(NSMutableData *)data;
+/// Valid options are NBTLittleEndian and the compression options; compressed output is deflated as it's written
+- (instancetype)initWithStream:(NSOutputStream *)stream options:(NBTOptions)opt;
+- (instancetype)initWithData:(NSMutableData *)data options:(NBTOptions)opt;
+/// Returns the number of bytes written to the destination, or 0 on failure
 - (NSInteger)writeRootTag:(NSDictionary*)root withName:(NSString *)name error:(NSError **)error;
+/// Writes any NBT object as SNBT text, returns the number of bytes written or 0 on failure
+- (NSInteger)writeSNBT:(id)obj error:(NSError **)error;
 
 @end
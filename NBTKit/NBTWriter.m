@@ -9,44 +9,174 @@
 #import "NBTWriter.h"
 #import "NBTKit.h"
 #import "NBTKit_Private.h"
+#import "NBTByteSwap.h"
+#import "NBTHash.h"
+#import <zlib.h>
+
+#define NBTWriterBufferSize (64*1024)
 
 @implementation NBTWriter
 {
     NSOutputStream *stream;
+    NSMutableData *output;
+    // UTF-8 strings for SNBT
+    NSMutableData *scratch;
+    // output data when writing uncompressed data, otherwise buffer to flush
+    NSMutableData *data;
+    uint8_t *bytes;
+    NSUInteger used, capacity, startLength;
+    BOOL buffered;
+    // compression
+    z_stream *zstream;
+    uint8_t *zbuf;
+    int zerr;
+    // statistics
+    uint64_t statsStart, deflateTime;
+    NBTHashState hashState;
 }
 
 - (instancetype)initWithStream:(NSOutputStream *)aStream
 {
-    if ((self = [super init])) {
+    return [self initWithStream:aStream options:0];
+}
+
+- (instancetype)initWithStream:(NSOutputStream *)aStream options:(NBTOptions)opt
+{
+    if ((self = [self initWithOptions:opt])) {
         stream = aStream;
         [stream open];
+        [self setBuffer:[NSMutableData dataWithLength:NBTWriterBufferSize]];
+    }
+    return self;
+}
+
+- (instancetype)initWithData:(NSMutableData *)aData
+{
+    return [self initWithData:aData options:0];
+}
+
+- (instancetype)initWithData:(NSMutableData *)aData options:(NBTOptions)opt
+{
+    if ((self = [self initWithOptions:opt])) {
+        output = aData;
+        startLength = output.length;
+        if (zstream) {
+            [self setBuffer:[NSMutableData dataWithLength:NBTWriterBufferSize]];
+        } else {
+            // encode straight into the output
+            buffered = NO;
+            [self setBuffer:output];
+            used = startLength;
+        }
     }
     return self;
 }
 
+- (instancetype)initWithOptions:(NBTOptions)opt
+{
+    if ((self = [super init])) {
+        _littleEndian = opt & NBTLittleEndian;
+        buffered = YES;
+        if (opt & NBTCompressed) {
+            int level = MIN((int)((opt & NBTCompressionLevelMask) >> 8) - 1, Z_BEST_COMPRESSION);
+            int strategy = (int)((opt & NBTCompressionStrategyMask) >> 12);
+            zbuf = malloc(NBTWriterBufferSize);
+            zstream = calloc(1, sizeof(z_stream));
+            zerr = deflateInit2(zstream, level, Z_DEFLATED, opt & NBTUseZlib ? 15 : 31, 8, strategy);
+        }
+    }
+    return self;
+}
+
+- (void)setBuffer:(NSMutableData *)buffer
+{
+    data = buffer;
+    bytes = data.mutableBytes;
+    capacity = data.length;
+}
+
+- (void)setHashesPayload:(BOOL)hashesPayload
+{
+    _hashesPayload = hashesPayload;
+    if (hashesPayload && !buffered) {
+        // hash the blocks as they're emitted
+        buffered = YES;
+        [self setBuffer:[NSMutableData dataWithLength:NBTWriterBufferSize]];
+        used = 0;
+    }
+}
+
+- (void)dealloc
+{
+    if (zstream) {
+        deflateEnd(zstream);
+        free(zstream);
+    }
+    free(zbuf);
+}
+
 - (NSInteger)writeRootTag:(NSDictionary*)root withName:(NSString *)name error:(NSError **)error
 {
-    @try {
+    return [self performWrite:^NSInteger{
         return [self writeTag:root withName:name];
+    } error:error];
+}
+
+- (NSInteger)writeSNBT:(id)obj error:(NSError **)error
+{
+    return [self performWrite:^NSInteger{
+        return [self writeSNBTTag:obj];
+    } error:error];
+}
+
+// writes with block, then flushes the output, or discards it if writing fails
+- (NSInteger)performWrite:(NSInteger (^)(void))block error:(NSError **)error
+{
+    statsStart = NBTStatisticsStart();
+    deflateTime = 0;
+    if (_hashesPayload) NBTHashInit(&hashState);
+    @try {
+        NSInteger bw = block();
+        NBTStatisticsAdd(NBTStatisticBytesWritten, bw);
+        if (buffered) {
+            [self flush];
+            if (_hashesPayload) _payloadHash = NBTHashFinal(&hashState);
+            if (zstream) {
+                bw = [self deflate:NULL length:0 flush:Z_FINISH];
+                NBTStatisticsAdd(NBTStatisticCompressedBytesWritten, bw);
+            }
+        } else {
+            data.length = used;
+        }
+        return bw;
     }
     @catch (NSException *exception) {
+        output.length = startLength;
         if (error) *error = [NBTKit _errorFromException:exception];
         return 0;
     }
+    @finally {
+        if (statsStart) {
+            uint64_t elapsed = mach_absolute_time() - statsStart;
+            NBTStatisticsAdd(NBTStatisticDeflateTime, deflateTime);
+            NBTStatisticsAdd(NBTStatisticSerializeTime, elapsed - MIN(deflateTime, elapsed));
+        }
+    }
 }
 
 - (NSInteger)writeTag:(id)obj withName:(NSString *)name
 {
     NBTType tag = [NBTKit NBTTypeForObject:obj];
-    NSInteger bytes = 0;
+    if (tag == NBTTypeInvalid) [self invalidObject:obj];
+    NSInteger bw = 0;
     // tag type
-    bytes += [self writeByte:tag];
+    bw += [self writeByte:tag];
     // name
-    bytes += [self writeString:name];
+    bw += [self writeString:name];
     // payload
-    bytes += [self writeTag:obj ofType:tag];
+    bw += [self writeTag:obj ofType:tag];
     
-    return bytes;
+    return bw;
 }
 
 - (NSInteger)writeTag:(id)obj ofType:(NBTType)tag
@@ -83,6 +213,12 @@
     }
 }
 
+// objects are validated as they are written, the output is discarded if any is invalid
+- (void)invalidObject:(id)obj
+{
+    @throw [NSException exceptionWithName:@"NBTTypeException" reason:@"Invalid NBT object" userInfo:@{@"class": NSStringFromClass([obj class]) ?: @"nil"}];
+}
+
 - (void)writeError
 {
     NSMutableDictionary *userInfo = @{
@@ -97,42 +233,124 @@
     @throw [NSException exceptionWithName:@"NBTWriteException" reason:stream.streamError.description ?: @"Error writing NBT." userInfo:userInfo];
 }
 
+- (void)zlibError
+{
+    NSError *error = [NBTKit _errorFromZlibError:zerr];
+    @throw [NSException exceptionWithName:@"NBTWriteException" reason:error.userInfo[@"message"] userInfo:@{@"error": error}];
+}
+
+#pragma mark - Buffering
+
+- (void)writeOutput:(const uint8_t*)buf length:(NSUInteger)len
+{
+    if (output) {
+        [output appendBytes:buf length:len];
+        return;
+    }
+    while (len > 0) {
+        NSInteger bw = [stream write:buf maxLength:len];
+        if (bw <= 0) [self writeError];
+        buf += bw;
+        len -= bw;
+    }
+}
+
+// compresses len bytes to the output, returns the total compressed length
+- (NSInteger)deflate:(const uint8_t*)buf length:(NSUInteger)len flush:(int)flush
+{
+    if (zerr != Z_OK) [self zlibError];
+    zstream->next_in = (Bytef*)buf;
+    zstream->avail_in = (uInt)len;
+    do {
+        zstream->next_out = zbuf;
+        zstream->avail_out = NBTWriterBufferSize;
+        uint64_t start = statsStart ? mach_absolute_time() : 0;
+        zerr = deflate(zstream, flush);
+        if (start) deflateTime += mach_absolute_time() - start;
+        if (zerr == Z_STREAM_ERROR) [self zlibError];
+        [self writeOutput:zbuf length:NBTWriterBufferSize - zstream->avail_out];
+    } while (zstream->avail_out == 0);
+    zerr = Z_OK;
+    return zstream->total_out;
+}
+
+- (void)emit:(const uint8_t*)buf length:(NSUInteger)len
+{
+    if (_hashesPayload) NBTHashUpdate(&hashState, buf, len);
+    if (zstream) {
+        [self deflate:buf length:len flush:Z_NO_FLUSH];
+    } else {
+        [self writeOutput:buf length:len];
+    }
+}
+
+- (void)flush
+{
+    [self emit:bytes length:used];
+    used = 0;
+}
+
+- (void)grow:(NSUInteger)len
+{
+    if (buffered) {
+        [self flush];
+        if (capacity >= len) return;
+    }
+    capacity = MAX(2 * capacity, MAX(used + len, 4096));
+    data.length = capacity;
+    NBTStatisticsAdd(NBTStatisticAllocations, 1);
+    bytes = data.mutableBytes;
+}
+
+// returns a pointer to write len bytes at
+- (uint8_t*)reserve:(NSUInteger)len
+{
+    if (capacity - used < len) [self grow:len];
+    uint8_t *buf = bytes + used;
+    used += len;
+    return buf;
+}
+
 #pragma mark - Write basic types
 
-- (NSInteger)write:(NSData*)data
+- (NSInteger)write:(const void*)buf length:(NSUInteger)len
 {
-    if (data == nil || data.length == 0) return 0;
-    if ([stream write:data.bytes maxLength:data.length] != data.length) [self writeError];
-    return data.length;
+    if (buffered && capacity - used < len) {
+        [self flush];
+        if (len >= capacity) {
+            // big blocks go straight to the output
+            [self emit:buf length:len];
+            return len;
+        }
+    }
+    if (len) memcpy([self reserve:len], buf, len);
+    return len;
 }
 
 - (NSInteger)writeByte:(int8_t)val
 {
-    if ([stream write:(const uint8_t*)&val maxLength:1] != 1) [self writeError];
+    *[self reserve:1] = val;
     return 1;
 }
 
 - (NSInteger)writeShort:(int16_t)val
 {
-    uint8_t buf[2];
+    uint8_t *buf = [self reserve:2];
     _littleEndian ? OSWriteLittleInt16(buf, 0, val) : OSWriteBigInt16(buf, 0, val);
-    if ([stream write:buf maxLength:sizeof buf] != 2) [self writeError];
     return 2;
 }
 
 - (NSInteger)writeInt:(int32_t)val
 {
-    uint8_t buf[4];
+    uint8_t *buf = [self reserve:4];
     _littleEndian ? OSWriteLittleInt32(buf, 0, val) : OSWriteBigInt32(buf, 0, val);
-    if ([stream write:buf maxLength:sizeof buf] != 4) [self writeError];
     return 4;
 }
 
 - (NSInteger)writeLong:(int64_t)val
 {
-    uint8_t buf[8];
+    uint8_t *buf = [self reserve:8];
     _littleEndian ? OSWriteLittleInt64(buf, 0, val) : OSWriteBigInt64(buf, 0, val);
-    if ([stream write:buf maxLength:sizeof buf] != 8) [self writeError];
     return 8;
 }
 
@@ -152,17 +370,30 @@
 {
     NSInteger bw = 0;
     bw += [self writeInt:(int32_t)data.length];
-    bw += [self write:data];
+    bw += [self write:data.bytes length:data.length];
     return bw;
 }
 
 - (NSInteger)writeString:(NSString*)str
 {
-    NSInteger bw = 0;
-    NSData *data = [str dataUsingEncoding:NSUTF8StringEncoding];
-    bw += [self writeShort:data.length];
-    bw += [self write:data];
-    return bw;
+    NSUInteger length = str.length;
+    if (length == 0) return [self writeShort:0];
+    
+    // copy directly if the string is stored as UTF-8
+    const char *cstr = CFStringGetCStringPtr((__bridge CFStringRef)str, kCFStringEncodingUTF8);
+    NSUInteger len = cstr ? strlen(cstr) : 0;
+    if (cstr && len >= length) {
+        [self writeShort:(int16_t)len];
+        return 2 + [self write:cstr length:len];
+    }
+    
+    // encode into the buffer
+    NSUInteger maxLen = [str maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    uint8_t *buf = [self reserve:2 + maxLen];
+    [str getBytes:buf + 2 maxLength:maxLen usedLength:&len encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, length) remainingRange:NULL];
+    _littleEndian ? OSWriteLittleInt16(buf, 0, (uint16_t)len) : OSWriteBigInt16(buf, 0, (uint16_t)len);
+    used -= maxLen - len;
+    return 2 + len;
 }
 
 - (NSInteger)writeList:(NSArray*)list
@@ -170,9 +401,13 @@
     NBTType tag = NBTTypeByte;
     NSInteger bw = 0;
     if (list.count) tag = [NBTKit NBTTypeForObject:list.firstObject];
+    if (tag == NBTTypeInvalid) [self invalidObject:list.firstObject];
     bw += [self writeByte:tag];
     bw += [self writeInt:(int32_t)list.count];
     for (id obj in list) {
+        if (NBTTypeOfObject(obj) != tag) {
+            @throw [NSException exceptionWithName:@"NBTTypeException" reason:@"List items must be of the same type" userInfo:@{@"tag": @(tag), @"class": NSStringFromClass([obj class])}];
+        }
         bw += [self writeTag:obj ofType:tag];
     }
     return bw;
@@ -182,8 +417,12 @@
 {
     NSInteger bw = 0;
     
-    // items
-    for (NSString *key in dict.nbtOrderedKeys) {
+    // items, NBTCompound enumerates its keys in order
+    id<NSFastEnumeration> keys = [dict isKindOfClass:[NBTCompound class]] ? dict : dict.nbtOrderedKeys;
+    for (NSString *key in keys) {
+        if (NBTTypeOfObject(key) != NBTTypeString) {
+            @throw [NSException exceptionWithName:@"NBTTypeException" reason:@"Compound keys must be strings" userInfo:@{@"class": NSStringFromClass([key class])}];
+        }
         bw += [self writeTag:dict[key] withName:key];
     }
     // TAG_End
@@ -191,36 +430,217 @@
     return bw;
 }
 
+// writes count values of size bytes from host byte order
+- (NSInteger)writeValues:(const void*)values count:(NSUInteger)count size:(size_t)size
+{
+    if (_littleEndian == NBTHostIsLittleEndian) return [self write:values length:count * size];
+    
+    // swap into the buffer in blocks that fit it
+    const uint8_t *src = values;
+    NSUInteger left = count;
+    NSUInteger block = buffered ? NBTWriterBufferSize / size : count;
+    while (left) {
+        NSUInteger n = MIN(left, block);
+        NBTCopyValues([self reserve:n * size], src, n, size, 1);
+        src += n * size;
+        left -= n;
+    }
+    return count * size;
+}
+
 - (NSInteger)writeIntArray:(NBTIntArray*)array
 {
     NSInteger bw = 0;
-    
-    // length
     bw += [self writeInt:(int32_t)array.count];
-    
-    // values
-    int32_t *values = array.values;
-    for (NSUInteger i=0; i < array.count; i++) {
-        bw += [self writeInt:values[i]];
+    const void *encoded = [array _encodedValuesInByteOrder:_littleEndian];
+    if (encoded) {
+        // unmodified since it was read, in the same byte order
+        bw += [self write:encoded length:array.count * sizeof(int32_t)];
+    } else {
+        bw += [self writeValues:array.values count:array.count size:sizeof(int32_t)];
     }
-    
     return bw;
 }
 
 - (NSInteger)writeLongArray:(NBTLongArray*)array
 {
     NSInteger bw = 0;
-    
-    // length
     bw += [self writeInt:(int32_t)array.count];
-    
-    // values
-    int64_t *values = array.values;
-    for (NSUInteger i=0; i < array.count; i++) {
-        bw += [self writeLong:values[i]];
+    const void *encoded = [array _encodedValuesInByteOrder:_littleEndian];
+    if (encoded) {
+        // unmodified since it was read, in the same byte order
+        bw += [self write:encoded length:array.count * sizeof(int64_t)];
+    } else {
+        bw += [self writeValues:array.values count:array.count size:sizeof(int64_t)];
     }
-    
     return bw;
 }
 
+#pragma mark - SNBT
+
+- (NSInteger)writeSNBTTag:(id)obj
+{
+    NBTType tag = [NBTKit NBTTypeForObject:obj];
+    switch (tag) {
+        case NBTTypeByte:
+            return [self writeSNBTInteger:[obj charValue] suffix:'b'];
+        case NBTTypeShort:
+            return [self writeSNBTInteger:[obj shortValue] suffix:'s'];
+        case NBTTypeInt:
+            return [self writeSNBTInteger:[obj intValue] suffix:0];
+        case NBTTypeLong:
+            return [self writeSNBTInteger:[obj longLongValue] suffix:'L'];
+        case NBTTypeFloat:
+        case NBTTypeDouble:
+            return [self writeSNBTFloat:[obj doubleValue] type:tag];
+        case NBTTypeString:
+            return [self writeSNBTString:obj];
+        case NBTTypeByteArray: {
+            NSData *data = obj;
+            const int8_t *values = data.bytes;
+            NSInteger bw = [self write:"[B;" length:3];
+            for (NSUInteger i=0; i < data.length; i++) {
+                if (i) bw += [self writeByte:','];
+                bw += [self writeSNBTInteger:values[i] suffix:'b'];
+            }
+            return bw + [self writeByte:']'];
+        }
+        case NBTTypeIntArray: {
+            NBTIntArray *array = obj;
+            NSInteger bw = [self write:"[I;" length:3];
+            for (NSUInteger i=0; i < array.count; i++) {
+                if (i) bw += [self writeByte:','];
+                bw += [self writeSNBTInteger:[array valueAtIndex:i] suffix:0];
+            }
+            return bw + [self writeByte:']'];
+        }
+        case NBTTypeLongArray: {
+            NBTLongArray *array = obj;
+            NSInteger bw = [self write:"[L;" length:3];
+            for (NSUInteger i=0; i < array.count; i++) {
+                if (i) bw += [self writeByte:','];
+                bw += [self writeSNBTInteger:[array valueAtIndex:i] suffix:'L'];
+            }
+            return bw + [self writeByte:']'];
+        }
+        case NBTTypeList: {
+            NSArray *list = obj;
+            NBTType listType = list.count ? NBTTypeOfObject(list.firstObject) : NBTTypeInvalid;
+            NSInteger bw = [self writeByte:'['];
+            for (id item in list) {
+                if (NBTTypeOfObject(item) != listType) {
+                    @throw [NSException exceptionWithName:@"NBTTypeException" reason:@"List items must be of the same type" userInfo:@{@"tag": @(listType), @"class": NSStringFromClass([item class])}];
+                }
+                if (bw > 1) bw += [self writeByte:','];
+                bw += [self writeSNBTTag:item];
+            }
+            return bw + [self writeByte:']'];
+        }
+        case NBTTypeCompound: {
+            NSDictionary *dict = obj;
+            id<NSFastEnumeration> keys = [dict isKindOfClass:[NBTCompound class]] ? dict : dict.nbtOrderedKeys;
+            NSInteger bw = [self writeByte:'{'];
+            for (NSString *key in keys) {
+                if (NBTTypeOfObject(key) != NBTTypeString) {
+                    @throw [NSException exceptionWithName:@"NBTTypeException" reason:@"Compound keys must be strings" userInfo:@{@"class": NSStringFromClass([key class])}];
+                }
+                if (bw > 1) bw += [self writeByte:','];
+                bw += [self writeSNBTKey:key];
+                bw += [self writeByte:':'];
+                bw += [self writeSNBTTag:dict[key]];
+            }
+            return bw + [self writeByte:'}'];
+        }
+        default:
+            [self invalidObject:obj];
+            return 0;
+    }
+}
+
+- (NSInteger)writeSNBTInteger:(int64_t)value suffix:(char)suffix
+{
+    char buf[24];
+    char *p = buf + sizeof buf;
+    if (suffix) *--p = suffix;
+    uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) *--p = '-';
+    return [self write:p length:buf + sizeof buf - p];
+}
+
+// writes the shortest representation that reads back as the same value
+- (NSInteger)writeSNBTFloat:(double)value type:(NBTType)type
+{
+    char buf[40];
+    int len = 0;
+    if (isnan(value) || isinf(value)) {
+        // as written by Minecraft, read back by NBTKit
+        len = snprintf(buf, sizeof buf, "%s", isnan(value) ? "NaN" : value < 0 ? "-Infinity" : "Infinity");
+    } else if (type == NBTTypeFloat) {
+        // 9 digits always round-trip a float
+        for (int precision = 7; precision <= 9; precision++) {
+            len = snprintf(buf, sizeof buf, "%.*g", precision, value);
+            if (strtof(buf, NULL) == (float)value) break;
+        }
+    } else {
+        // 17 digits always round-trip a double
+        for (int precision = 15; precision <= 17; precision++) {
+            len = snprintf(buf, sizeof buf, "%.*g", precision, value);
+            if (strtod(buf, NULL) == value) break;
+        }
+    }
+    buf[len++] = type == NBTTypeFloat ? 'f' : 'd';
+    return [self write:buf length:len];
+}
+
+// returns the UTF-8 bytes of a string, which are valid until the next call
+- (const char*)UTF8BytesOfString:(NSString*)str length:(NSUInteger*)outLength
+{
+    NSUInteger length = str.length;
+    const char *cstr = CFStringGetCStringPtr((__bridge CFStringRef)str, kCFStringEncodingUTF8);
+    NSUInteger len = cstr ? strlen(cstr) : 0;
+    if (cstr && len >= length) {
+        *outLength = len;
+        return cstr;
+    }
+    NSUInteger maxLen = [str maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    if (scratch == nil) scratch = [NSMutableData new];
+    if (scratch.length < maxLen) scratch.length = maxLen;
+    [str getBytes:scratch.mutableBytes maxLength:maxLen usedLength:&len encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, length) remainingRange:NULL];
+    *outLength = len;
+    return scratch.bytes;
+}
+
+- (NSInteger)writeSNBTString:(NSString*)str
+{
+    NSUInteger len;
+    const char *s = [self UTF8BytesOfString:str length:&len];
+    NSInteger bw = [self writeByte:'"'];
+    const char *run = s, *end = s + len;
+    for (const char *c = s; c < end; c++) {
+        if (*c != '"' && *c != '\\') continue;
+        bw += [self write:run length:c - run];
+        bw += [self writeByte:'\\'];
+        run = c;
+    }
+    bw += [self write:run length:end - run];
+    return bw + [self writeByte:'"'];
+}
+
+// keys are only quoted if needed
+- (NSInteger)writeSNBTKey:(NSString*)key
+{
+    NSUInteger len;
+    const char *s = [self UTF8BytesOfString:key length:&len];
+    BOOL quote = len == 0;
+    for (NSUInteger i=0; i < len && !quote; i++) {
+        char c = s[i];
+        quote = !((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '-' || c == '.' || c == '+');
+    }
+    return quote ? [self writeSNBTString:key] : [self write:s length:len];
+}
+
 @end
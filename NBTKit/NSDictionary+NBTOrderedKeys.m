@@ -20,6 +20,17 @@ static void * NBTOrderedKeysKey = &NBTOrderedKeysKey;
         orderedKeys = [NSMutableOrderedSet orderedSetWithCapacity:self.count];
         objc_setAssociatedObject(self, NBTOrderedKeysKey, orderedKeys, OBJC_ASSOCIATION_RETAIN);
     }
+    if (orderedKeys.count == self.count) {
+        // still in sync unless keys were replaced, no need to rebuild sets
+        BOOL inSync = YES;
+        for (NSString *key in orderedKeys) {
+            if (self[key] == nil) {
+                inSync = NO;
+                break;
+            }
+        }
+        if (inSync) return orderedKeys;
+    }
     NSSet *allKeysSet = [NSSet setWithArray:self.allKeys];
     [orderedKeys intersectSet:allKeysSet];
     [orderedKeys unionSet:allKeysSet];
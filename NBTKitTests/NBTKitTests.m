@@ -8,6 +8,7 @@
 
 #import <XCTest/XCTest.h>
 #import <NBTKit/NBTKit.h>
+#import <sys/stat.h>
 
 static uint8_t dataSample[1000] = {
     0x00,0x3e,0x22,0x10,0x08,0x0a,0x16,0x2c,0x4c,0x12,0x46,0x20,0x04,0x56,0x4e,0x50,
@@ -75,6 +76,92 @@ static uint8_t dataSample[1000] = {
     0x40,0x2e,0x26,0x28,0x34,0x4a,0x06,0x30
 };
 
+// rebuilds a tree from parser events
+@interface NBTTreeBuilder : NSObject <NBTParserDelegate>
+@property (nonatomic, strong) id root;
+@property (nonatomic, strong) NSMutableArray *stack, *names;
+@property (nonatomic, strong) NSMutableData *array;
+@property (nonatomic, assign) NBTType arrayType;
+@end
+
+@implementation NBTTreeBuilder
+
+- (void)add:(id)obj name:(NSString*)name
+{
+    id container = self.stack.lastObject;
+    if (container == nil) {
+        self.root = obj;
+    } else if ([container isKindOfClass:[NSArray class]]) {
+        [container addObject:obj];
+    } else {
+        container[name] = obj;
+    }
+}
+
+- (void)parser:(NBTParser *)parser didStartCompoundWithName:(NSString *)name
+{
+    NSMutableDictionary *compound = [NSMutableDictionary dictionary];
+    [self add:compound name:name];
+    [self.stack addObject:compound];
+}
+
+- (void)parserDidEndCompound:(NBTParser *)parser
+{
+    [self.stack removeLastObject];
+}
+
+- (void)parser:(NBTParser *)parser didStartListWithName:(NSString *)name type:(NBTType)type count:(NSUInteger)count
+{
+    NSMutableArray *list = [NSMutableArray arrayWithCapacity:count];
+    [self add:list name:name];
+    [self.stack addObject:list];
+}
+
+- (void)parserDidEndList:(NBTParser *)parser
+{
+    [self.stack removeLastObject];
+}
+
+- (void)parser:(NBTParser *)parser foundInteger:(int64_t)value type:(NBTType)type name:(NSString *)name
+{
+    id obj = type == NBTTypeByte ? NBTByte(value) : type == NBTTypeShort ? NBTShort(value) : type == NBTTypeInt ? NBTInt(value) : NBTLong(value);
+    [self add:obj name:name];
+}
+
+- (void)parser:(NBTParser *)parser foundFloat:(double)value type:(NBTType)type name:(NSString *)name
+{
+    [self add:type == NBTTypeFloat ? NBTFloat(value) : NBTDouble(value) name:name];
+}
+
+- (void)parser:(NBTParser *)parser foundString:(NSString *)string name:(NSString *)name
+{
+    [self add:string name:name];
+}
+
+- (void)parser:(NBTParser *)parser didStartArrayWithName:(NSString *)name type:(NBTType)type count:(NSUInteger)count
+{
+    self.array = [NSMutableData data];
+    self.arrayType = type;
+    [self.names addObject:name ?: @""];
+}
+
+- (void)parser:(NBTParser *)parser foundArrayValues:(const void *)values count:(NSUInteger)count
+{
+    NSUInteger size = self.arrayType == NBTTypeByteArray ? 1 : self.arrayType == NBTTypeIntArray ? 4 : 8;
+    [self.array appendBytes:values length:count * size];
+}
+
+- (void)parserDidEndArray:(NBTParser *)parser
+{
+    id obj = self.array;
+    if (self.arrayType == NBTTypeIntArray) obj = [NBTIntArray intArrayWithValues:self.array.bytes count:self.array.length / 4];
+    if (self.arrayType == NBTTypeLongArray) obj = [NBTLongArray longArrayWithValues:self.array.bytes count:self.array.length / 8];
+    [self add:obj name:self.names.lastObject];
+    [self.names removeLastObject];
+}
+
+@end
+
 @interface NBTKitTests : XCTestCase
 
 @end
@@ -174,6 +261,18 @@ static uint8_t dataSample[1000] = {
     XCTAssertEqualObjects(root, bigTest, @"bigTest (read file)");
 }
 
+- (void)testReadNBTTruncated
+{
+    NSData *data = [NSData dataWithContentsOfFile:[self pathForResource:@"bigtest_uncompressed.nbt"]];
+    NSError *error = nil;
+    NSMutableDictionary *root = [NBTKit NBTWithData:[data subdataWithRange:NSMakeRange(0, data.length - 16)] name:NULL options:0 error:&error];
+    XCTAssertNil(root, @"truncated NBT");
+    XCTAssertEqual(error.code, NBTReadError, @"truncated NBT read error");
+    
+    root = [NBTKit NBTWithStream:[NSInputStream inputStreamWithData:data] name:NULL options:0 error:NULL];
+    XCTAssertEqualObjects(root, bigTest, @"bigTest (read stream)");
+}
+
 - (void)testWriteNBT
 {
     NSData *data = [NBTKit dataWithNBT:bigTest name:@"root" options:0 error:NULL];
@@ -182,11 +281,173 @@ static uint8_t dataSample[1000] = {
     XCTAssertEqualObjects(root, bigTest, @"bigTest (write and read)");
 }
 
+- (void)testWriteInvalidNBT
+{
+    NSArray *invalid = @[
+        @{@"list": @[NBTInt(1), NBTShort(2)]},
+        @{@"number": @1},
+        @{@1: NBTInt(1)},
+        @{@"nested": @{@"list": @[@[NBTInt(1)], @[@"a", [NSDate date]]]}},
+    ];
+    NSData *valid = [NBTKit dataWithNBT:bigTest name:@"Level" options:0 error:NULL];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"invalid.nbt"];
+    XCTAssertTrue([valid writeToFile:path atomically:NO]);
+    for (NSDictionary *root in invalid) {
+        XCTAssertFalse([NBTKit isValidNBTObject:root], @"%@", root);
+        NSError *error = nil;
+        XCTAssertNil([NBTKit dataWithNBT:root name:nil options:NBTCompressed error:&error], @"%@", root);
+        XCTAssertEqual(error.code, NBTTypeError, @"%@", root);
+        error = nil;
+        XCTAssertEqual([NBTKit writeNBT:root name:nil toFile:path options:0 error:&error], 0, @"%@", root);
+        XCTAssertEqual(error.code, NBTTypeError, @"%@", root);
+        XCTAssertEqualObjects([NSData dataWithContentsOfFile:path], valid, @"file unchanged after failed write");
+    }
+    XCTAssertTrue([NBTKit isValidNBTObject:bigTest]);
+    XCTAssertGreaterThan([NBTKit writeNBT:bigTest name:@"Level" toFile:path options:NBTCompressed error:NULL], 0);
+    XCTAssertEqualObjects([NBTKit NBTWithFile:path name:NULL options:NBTCompressed error:NULL], bigTest, @"file replaced after write");
+    
+    // writing through a symlink replaces its target
+    NSString *linkPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"link.nbt"];
+    [[NSFileManager defaultManager] removeItemAtPath:linkPath error:NULL];
+    XCTAssertTrue([[NSFileManager defaultManager] createSymbolicLinkAtPath:linkPath withDestinationPath:path error:NULL]);
+    XCTAssertGreaterThan([NBTKit writeNBT:bigTest name:@"Level" toFile:linkPath options:0 error:NULL], 0);
+    XCTAssertEqualObjects([[NSFileManager defaultManager] attributesOfItemAtPath:linkPath error:NULL].fileType, NSFileTypeSymbolicLink);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:path], valid, @"symlink target replaced");
+    [[NSFileManager defaultManager] removeItemAtPath:linkPath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    
+    // new files get the permissions allowed by the umask
+    mode_t mask = umask(027);
+    XCTAssertGreaterThan([NBTKit writeNBT:bigTest name:@"Level" toFile:path options:0 error:NULL], 0);
+    umask(mask);
+    XCTAssertEqual([[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL].filePosixPermissions, (NSUInteger)0640);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCompoundOrder
+{
+    NSData *data = [NSData dataWithContentsOfFile:[self pathForResource:@"bigtest_uncompressed.nbt"]];
+    NSMutableDictionary *root = [NBTKit NBTWithData:data name:NULL options:0 error:NULL];
+    XCTAssertTrue([root isKindOfClass:[NBTCompound class]], @"compounds are read as NBTCompound");
+    XCTAssertEqualObjects([NBTKit dataWithNBT:root name:@"Level" options:0 error:NULL], data, @"key order kept when writing");
+    
+    NBTCompound *compound = [NBTCompound new];
+    NSArray *keys = @[@"z", @"a", @"m", @"b"];
+    for (NSString *key in keys) compound[key] = NBTInt(1);
+    compound[@"a"] = NBTInt(2);
+    XCTAssertEqualObjects(compound.allKeys, keys, @"insertion order");
+    XCTAssertEqualObjects(compound.nbtOrderedKeys.array, keys, @"nbtOrderedKeys");
+    XCTAssertEqualObjects(compound[@"a"], NBTInt(2));
+    [compound removeObjectForKey:@"m"];
+    compound[@"m"] = NBTInt(3);
+    keys = @[@"z", @"a", @"b", @"m"];
+    XCTAssertEqualObjects(compound.allKeys, keys, @"order after removing and adding");
+    XCTAssertEqualObjects([compound.mutableCopy allKeys], keys, @"order kept by mutableCopy");
+    NBTCompound *frozen = [compound copy];
+    XCTAssertEqualObjects(frozen.allKeys, keys, @"order kept by copy");
+    XCTAssertThrows(frozen[@"x"] = NBTInt(1), @"copy is immutable");
+    XCTAssertThrows([frozen removeObjectForKey:@"a"], @"copy is immutable");
+    XCTAssertEqual([frozen copy], frozen);
+    NBTCompound *thawed = [frozen mutableCopy];
+    thawed[@"x"] = NBTInt(4);
+    XCTAssertEqual(thawed.count, frozen.count + 1, @"mutableCopy is mutable");
+    XCTAssertEqualObjects(compound, (@{@"z": NBTInt(1), @"a": NBTInt(2), @"b": NBTInt(1), @"m": NBTInt(3)}), @"equal to NSDictionary");
+    
+    compound.nbtOrderedKeys = [NSOrderedSet orderedSetWithArray:@[@"m", @"missing", @"z"]];
+    XCTAssertEqualObjects(compound.allKeys, (@[@"m", @"z", @"a", @"b"]), @"setting nbtOrderedKeys");
+}
+
+- (void)testInternTable
+{
+    NSData *data = [NSData dataWithContentsOfFile:[self pathForResource:@"bigtest_uncompressed.nbt"]];
+    NSMutableDictionary *root1 = [NBTKit NBTWithData:data name:NULL options:NBTInternStrings error:NULL];
+    NSMutableDictionary *root2 = [NBTKit NBTWithData:data name:NULL options:NBTInternStrings error:NULL];
+    XCTAssertEqualObjects(root1, bigTest, @"bigTest (interned)");
+    XCTAssertEqual(root1.allKeys.firstObject, root2.allKeys.firstObject, @"keys are shared");
+    XCTAssertEqual(root1[@"byteTest"], root2[@"byteTest"], @"bytes are shared");
+    
+    NBTInternTable *table = [NBTInternTable new];
+    NSString *ascii = [table stringWithUTF8Bytes:"minecraft:stone" length:15];
+    XCTAssertEqualObjects(ascii, @"minecraft:stone");
+    XCTAssertEqual([table stringWithUTF8Bytes:"minecraft:stone" length:15], ascii);
+    NSString *utf8 = [table stringWithUTF8Bytes:"\xc3\xa1rbol" length:6];
+    XCTAssertEqualObjects(utf8, @"\u00e1rbol");
+    XCTAssertEqual([table stringWithUTF8Bytes:"\xc3\xa1rbol" length:6], utf8);
+    XCTAssertNil([table stringWithUTF8Bytes:"\xc3" length:1], @"invalid UTF-8");
+    XCTAssertEqualObjects([table stringWithUTF8Bytes:"" length:0], @"");
+    NSString *longString = [@"" stringByPaddingToLength:100 withString:@"x" startingAtIndex:0];
+    XCTAssertEqualObjects([table stringWithUTF8Bytes:longString.UTF8String length:100], longString, @"long strings are not interned");
+    XCTAssertEqual(table.count, (NSUInteger)2);
+    XCTAssertEqual([table byteWithValue:-5], [table byteWithValue:-5]);
+    XCTAssertEqualObjects([table byteWithValue:-5], NBTByte(-5));
+    XCTAssertEqual([table shortWithValue:300], [table shortWithValue:300]);
+    XCTAssertEqualObjects([table shortWithValue:-30000], NBTShort(-30000));
+    [table removeAllStrings];
+    XCTAssertEqual(table.count, (NSUInteger)0);
+    XCTAssertEqualObjects(ascii, @"minecraft:stone", @"strings stay valid");
+}
+
+- (void)testSNBT
+{
+    NSError *error = nil;
+    NSString *snbt = [NBTKit SNBTWithNBT:bigTest error:&error];
+    XCTAssertNotNil(snbt, @"write bigTest as SNBT: %@", error);
+    XCTAssertEqualObjects([NBTKit NBTWithSNBT:snbt error:NULL], bigTest, @"read bigTest from SNBT");
+    
+    int32_t ints[] = {1, -2};
+    int64_t longs[] = {INT64_MIN};
+    NBTCompound *root = [NBTCompound new];
+    root[@"b"] = NBTByte(-1);
+    root[@"s"] = NBTShort(2);
+    root[@"i"] = NBTInt(3);
+    root[@"l"] = NBTLong(4);
+    root[@"f"] = NBTFloat(0.1f);
+    root[@"d"] = NBTDouble(0.5);
+    root[@"a b"] = @"say \"hi\" \\";
+    root[@"ba"] = [NSData dataWithBytes:"\x01\xff" length:2];
+    root[@"ia"] = [NBTIntArray intArrayWithValues:ints count:2];
+    root[@"la"] = [NBTLongArray longArrayWithValues:longs count:1];
+    root[@"list"] = @[@"x", @"y"];
+    root[@"empty"] = @{};
+    snbt = @"{b:-1b,s:2s,i:3,l:4L,f:0.1f,d:0.5d,\"a b\":\"say \\\"hi\\\" \\\\\",ba:[B;1b,-1b],ia:[I;1,-2],la:[L;-9223372036854775808L],list:[\"x\",\"y\"],empty:{}}";
+    XCTAssertEqualObjects([NBTKit SNBTWithNBT:root error:NULL], snbt, @"write SNBT");
+    XCTAssertEqualObjects([NBTKit NBTWithSNBT:snbt error:NULL], root, @"read SNBT");
+    XCTAssertEqual([[NBTKit NBTWithSNBT:snbt error:NULL][@"list"] nbtListType], NBTTypeString, @"list type");
+    XCTAssertEqualObjects([NBTKit SNBTWithNBT:@{@"f": NBTFloat(1.0f/3)} error:NULL], @"{f:0.33333334f}", @"shortest float digits");
+    XCTAssertEqualObjects([NBTKit SNBTWithNBT:@{@"d": NBTDouble(1.0/3)} error:NULL], @"{d:0.3333333333333333d}", @"shortest double digits");
+    
+    // other syntax
+    NSDictionary *value = [NBTKit NBTWithSNBT:@" { 'q' : 'it\\'s' , u: stone_bricks, t: true, n: 1.5, e: 1e3f, big: 3000000000, c: [I;] } " error:NULL];
+    XCTAssertEqualObjects(value[@"q"], @"it's");
+    XCTAssertEqualObjects(value[@"u"], @"stone_bricks", @"unquoted string");
+    XCTAssertEqualObjects(value[@"t"], NBTByte(1));
+    XCTAssertEqualObjects(value[@"n"], NBTDouble(1.5));
+    XCTAssertEqualObjects(value[@"e"], NBTFloat(1000));
+    XCTAssertEqualObjects(value[@"big"], @"3000000000", @"out of range integers are strings");
+    XCTAssertEqualObjects(value[@"c"], [NBTIntArray intArrayWithCount:0]);
+    
+    XCTAssertNil([NBTKit NBTWithSNBT:@"{a:1" error:&error]);
+    XCTAssertEqual(error.code, NBTReadError);
+    XCTAssertNil([NBTKit NBTWithSNBT:@"[1,2b]" error:NULL], @"mixed list");
+    XCTAssertNil([NBTKit NBTWithSNBT:@"{a:1} x" error:NULL], @"trailing data");
+    XCTAssertNil([NBTKit SNBTWithNBT:@{@"a": [NSDate date]} error:&error], @"invalid object");
+    XCTAssertEqual(error.code, NBTTypeError);
+}
+
 - (void)testReadNBTCompressed
 {
     NSMutableDictionary *root = [NBTKit NBTWithFile:[self pathForResource:@"bigtest.nbt"] name:NULL options:NBTCompressed error:NULL];
     
     XCTAssertEqualObjects(root, bigTest, @"bigTest (read gzip file)");
+    
+    NSData *data = [NSData dataWithContentsOfFile:[self pathForResource:@"bigtest.nbt"]];
+    root = [NBTKit NBTWithStream:[NSInputStream inputStreamWithData:data] name:NULL options:NBTCompressed error:NULL];
+    XCTAssertEqualObjects(root, bigTest, @"bigTest (read gzip stream)");
+    
+    NSError *error = nil;
+    root = [NBTKit NBTWithStream:[NSInputStream inputStreamWithData:[data subdataWithRange:NSMakeRange(0, data.length / 2)]] name:NULL options:NBTCompressed error:&error];
+    XCTAssertNil(root, @"truncated gzip stream");
+    XCTAssertNotNil(error, @"truncated gzip stream error");
 }
 
 - (void)testWriteNBTCompressed
@@ -198,6 +459,219 @@ static uint8_t dataSample[1000] = {
     data = [NBTKit dataWithNBT:bigTest name:nil options:NBTCompressed+NBTUseZlib error:NULL];
     root = [NBTKit NBTWithData:data name:NULL options:NBTCompressed error:NULL];
     XCTAssertEqualObjects(root, bigTest, @"write zlib and decompress");
+    
+    NSData *fastData = [NBTKit dataWithNBT:bigTest name:nil options:NBTCompressed+NBTCompressionLevel(1) error:NULL];
+    NSData *bestData = [NBTKit dataWithNBT:bigTest name:nil options:NBTCompressed+NBTCompressionLevel(9)+NBTCompressionFiltered error:NULL];
+    XCTAssertEqualObjects([NBTKit NBTWithData:fastData name:NULL options:NBTCompressed error:NULL], bigTest, @"write gzip level 1 and decompress");
+    XCTAssertEqualObjects([NBTKit NBTWithData:bestData name:NULL options:NBTCompressed error:NULL], bigTest, @"write gzip level 9 and decompress");
+    XCTAssertLessThanOrEqual(bestData.length, fastData.length, @"level 9 is smaller than level 1");
+    
+    NSOutputStream *stream = [NSOutputStream outputStreamToMemory];
+    [stream open];
+    NSInteger bw = [NBTKit writeNBT:bigTest name:nil toStream:stream options:NBTCompressed error:NULL];
+    data = [stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+    XCTAssertEqual(bw, data.length, @"compressed bytes written to stream");
+    XCTAssertEqualObjects([NBTKit NBTWithData:data name:NULL options:NBTCompressed error:NULL], bigTest, @"write gzip stream and decompress");
+}
+
+- (void)testStatistics
+{
+    NSData *data = [NBTKit dataWithNBT:bigTest name:@"Level" options:0 error:NULL];
+    [NBTStatistics reset];
+    [NBTKit NBTWithData:data name:NULL options:0 error:NULL];
+    XCTAssertEqual([NBTStatistics snapshot].bytesRead, 0, @"disabled by default");
+    
+    NBTStatistics.enabled = YES;
+    NSData *compressed = [NBTKit dataWithNBT:bigTest name:@"Level" options:NBTCompressed error:NULL];
+    NBTStatistics *stats = [NBTStatistics snapshot];
+    XCTAssertEqual(stats.bytesWritten, data.length);
+    XCTAssertEqual(stats.compressedBytesWritten, compressed.length);
+    
+    [NBTStatistics reset];
+    [NBTKit NBTWithStream:[NSInputStream inputStreamWithData:compressed] name:NULL options:NBTCompressed error:NULL];
+    stats = [NBTStatistics snapshot];
+    NBTStatistics.enabled = NO;
+    XCTAssertEqual(stats.bytesRead, data.length);
+    XCTAssertEqual(stats.compressedBytesRead, compressed.length);
+    XCTAssertGreaterThan(stats.inflateTime, 0);
+    XCTAssertGreaterThan(stats.parseTime, 0);
+    XCTAssertEqual([stats tagsDecodedOfType:NBTTypeCompound], 6, @"compounds in bigtest");
+    XCTAssertEqual([stats tagsDecodedOfType:NBTTypeLong], 8, @"longs in bigtest");
+    XCTAssertEqualObjects(stats.dictionaryRepresentation[@"bytesRead"], @(data.length));
+    
+    [NBTStatistics reset];
+    XCTAssertEqual([NBTStatistics snapshot].bytesRead, 0, @"reset");
+}
+
+- (void)testParser
+{
+    NSMutableDictionary *root = bigTest.mutableCopy;
+    int64_t longs[] = {1, -2, INT64_MAX};
+    root[@"intArrayTest"] = [NBTIntArray intArrayWithCount:70000];
+    root[@"longArrayTest"] = [NBTLongArray longArrayWithValues:longs count:3];
+    for (int k=0; k < 3; k++) {
+        NBTOptions opt = k == 0 ? 0 : k == 1 ? NBTLittleEndian : NBTCompressed;
+        NSData *data = [NBTKit dataWithNBT:root name:@"Level" options:opt error:NULL];
+        NBTTreeBuilder *builder = [NBTTreeBuilder new];
+        builder.stack = [NSMutableArray array];
+        builder.names = [NSMutableArray array];
+        NBTParser *parser = [[NBTParser alloc] initWithData:data options:opt];
+        parser.delegate = builder;
+        XCTAssert([parser parse]);
+        XCTAssertNil(parser.parserError);
+        XCTAssertEqualObjects(builder.root, root, @"tree from parser events, options %d", (int)opt);
+    }
+    
+    // errors
+    NSData *data = [NBTKit dataWithNBT:root name:@"Level" options:0 error:NULL];
+    NBTParser *parser = [[NBTParser alloc] initWithData:[data subdataWithRange:NSMakeRange(0, data.length / 2)] options:0];
+    XCTAssertFalse([parser parse]);
+    XCTAssertEqual(parser.parserError.code, NBTReadError);
+}
+
+- (void)testDocument
+{
+    NSMutableDictionary *root = bigTest.mutableCopy;
+    int64_t longs[] = {1, -2, INT64_MAX};
+    root[@"longArrayTest"] = [NBTLongArray longArrayWithValues:longs count:3];
+    root[@"emptyList"] = @[];
+    for (int k=0; k < 2; k++) {
+        NBTOptions opt = k ? NBTLittleEndian : 0;
+        NSData *data = [NBTKit dataWithNBT:root name:@"Level" options:opt error:NULL];
+        NBTDocument *doc = [NBTDocument documentWithData:data options:opt error:NULL];
+        XCTAssertNotNil(doc);
+        XCTAssertEqualObjects(doc.rootName, @"Level");
+        XCTAssertEqualObjects(doc.rootTag, root, @"document to tree, options %d", (int)opt);
+        XCTAssertEqual([doc countOfNode:doc.rootNode], root.count);
+        
+        // lookups
+        XCTAssertEqual([doc integerValueOfNode:[doc nodeAtPath:@"intTest"]], 2147483647);
+        XCTAssertEqual([doc integerValueOfNode:[doc nodeAtPath:@"listTest (long).3"]], 14);
+        XCTAssertEqual([doc typeOfNode:[doc nodeAtPath:@"listTest (long).3"]], NBTTypeLong);
+        XCTAssertEqual([doc doubleValueOfNode:[doc nodeAtPath:@"nested compound test.ham.value"]], 0.75);
+        XCTAssertEqualObjects([doc stringValueOfNode:[doc nodeAtPath:@"listTest (compound).1.name"]], @"Compound tag #1");
+        XCTAssertEqualObjects([doc nameOfNode:[doc nodeAtPath:@"nested compound test.egg"]], @"egg");
+        XCTAssertEqual([doc nodeAtPath:@"listTest (long).5"], NBTNodeNotFound);
+        XCTAssertEqual([doc nodeAtPath:@"missing"], NBTNodeNotFound);
+        XCTAssertEqual([doc listTypeOfNode:[doc nodeAtPath:@"listTest (compound)"]], NBTTypeCompound);
+        int64_t values[3];
+        XCTAssertEqual([doc getValues:values range:NSMakeRange(1, 5) ofNode:[doc nodeAtPath:@"longArrayTest"]], 2);
+        XCTAssertEqual(values[0], -2);
+        XCTAssertEqual(values[1], INT64_MAX);
+    }
+    
+    XCTAssertEqualObjects([NBTDocument documentWithRootTag:root name:nil error:NULL].rootTag, root, @"tree to document");
+    
+    // errors
+    NSError *error = nil;
+    NSData *data = [NBTKit dataWithNBT:root name:@"Level" options:0 error:NULL];
+    XCTAssertNil([NBTDocument documentWithData:[data subdataWithRange:NSMakeRange(0, data.length - 1)] options:0 error:&error]);
+    XCTAssertEqual(error.code, NBTReadError);
+}
+
+- (void)testValuesAtPaths
+{
+    NSArray *paths = @[@"intTest", @"nested compound test.ham.name", @"listTest (long).2", @"listTest (compound).1", @"listTest (compound).1.name", @"missing", @"intTest.missing", @"listTest (long).5"];
+    NSDictionary *expected = @{
+        @"intTest": bigTest[@"intTest"],
+        @"nested compound test.ham.name": @"Hampus",
+        @"listTest (long).2": NBTLong(13),
+        @"listTest (compound).1": bigTest[@"listTest (compound)"][1],
+        @"listTest (compound).1.name": @"Compound tag #1"
+    };
+    NSData *data = [NBTKit dataWithNBT:bigTest name:@"Level" options:0 error:NULL];
+    XCTAssertEqualObjects([NBTKit valuesAtPaths:paths inData:data options:0 error:NULL], expected, @"values at paths");
+    data = [NBTKit dataWithNBT:bigTest name:@"Level" options:NBTCompressed error:NULL];
+    XCTAssertEqualObjects([NBTKit valuesAtPaths:paths inData:data options:NBTCompressed error:NULL], expected, @"values at paths (compressed)");
+    data = [NBTKit dataWithNBT:bigTest name:@"Level" options:NBTLittleEndian error:NULL];
+    XCTAssertEqualObjects([NBTKit valuesAtPaths:paths inData:data options:NBTLittleEndian error:NULL], expected, @"values at paths (little endian)");
+    XCTAssertEqualObjects([NBTKit valuesAtPaths:@[] inData:data options:NBTLittleEndian error:NULL], @{}, @"no paths");
+    
+    // truncated data
+    data = [NBTKit dataWithNBT:bigTest name:@"Level" options:0 error:NULL];
+    NSError *error = nil;
+    XCTAssertNil([NBTKit valuesAtPaths:@[@"missing"] inData:[data subdataWithRange:NSMakeRange(0, data.length - 1)] options:0 error:&error]);
+    XCTAssertEqual(error.code, NBTReadError);
+}
+
+- (void)testIntLongArrayByteOrder
+{
+    // odd counts to cover the scalar tail, large enough to span write buffers
+    NSUInteger counts[] = {0, 1, 7, 33, 20001};
+    for (int i=0; i < sizeof counts / sizeof *counts; i++) {
+        NSUInteger count = counts[i];
+        NBTIntArray *ints = [NBTIntArray intArrayWithCount:count];
+        NBTLongArray *longs = [NBTLongArray longArrayWithCount:count];
+        for (NSUInteger j=0; j < count; j++) {
+            ints.values[j] = (int32_t)(j * 2654435761u);
+            longs.values[j] = (int64_t)(j * 0x9E3779B97F4A7C15ull);
+        }
+        for (int k=0; k < 2; k++) {
+            NBTOptions opt = k ? NBTLittleEndian : 0;
+            // compare against scalar decoding of the written tags
+            NSData *data = [NBTKit dataWithNBT:@{@"i": ints} name:@"" options:opt error:NULL];
+            const uint8_t *bytes = (const uint8_t*)data.bytes + 7;
+            XCTAssertEqual(data.length, 12 + 4 * count);
+            XCTAssertEqual((NSUInteger)(k ? OSReadLittleInt32(bytes, 0) : OSReadBigInt32(bytes, 0)), count);
+            for (NSUInteger j=0; j < count; j++) {
+                int32_t val = k ? OSReadLittleInt32(bytes, 4 + 4*j) : OSReadBigInt32(bytes, 4 + 4*j);
+                if (val != ints.values[j]) XCTFail(@"int %lu of %lu, options %d", (unsigned long)j, (unsigned long)count, (int)opt);
+            }
+            XCTAssertEqualObjects([NBTKit NBTWithData:data name:NULL options:opt error:NULL][@"i"], ints, @"read int array");
+
+            data = [NBTKit dataWithNBT:@{@"l": longs} name:@"" options:opt error:NULL];
+            bytes = (const uint8_t*)data.bytes + 7;
+            XCTAssertEqual(data.length, 12 + 8 * count);
+            XCTAssertEqual((NSUInteger)(k ? OSReadLittleInt32(bytes, 0) : OSReadBigInt32(bytes, 0)), count);
+            for (NSUInteger j=0; j < count; j++) {
+                int64_t val = k ? OSReadLittleInt64(bytes, 4 + 8*j) : OSReadBigInt64(bytes, 4 + 8*j);
+                if (val != longs.values[j]) XCTFail(@"long %lu of %lu, options %d", (unsigned long)j, (unsigned long)count, (int)opt);
+            }
+            XCTAssertEqualObjects([NBTKit NBTWithData:data name:NULL options:opt error:NULL][@"l"], longs, @"read long array");
+
+            // buffered stream paths
+            NSOutputStream *output = [NSOutputStream outputStreamToMemory];
+            [output open];
+            [NBTKit writeNBT:@{@"l": longs} name:@"" toStream:output options:opt error:NULL];
+            XCTAssertEqualObjects([output propertyForKey:NSStreamDataWrittenToMemoryStreamKey], data, @"write long array to stream");
+            XCTAssertEqualObjects([NBTKit NBTWithStream:[NSInputStream inputStreamWithData:data] name:NULL options:opt error:NULL][@"l"], longs, @"read long array from stream");
+        }
+    }
+}
+
+- (void)testZeroCopyArrays
+{
+    int32_t ints[] = {1, -2, 0x12345678};
+    int64_t longs[] = {-1, 0x123456789ABCDEF0LL};
+    NSDictionary *root = @{@"b": [NSMutableData dataWithBytes:"\x01\x02\x03" length:3],
+                           @"i": [NBTIntArray intArrayWithValues:ints count:3],
+                           @"l": [NBTLongArray longArrayWithValues:longs count:2]};
+    for (int k=0; k < 2; k++) {
+        NBTOptions opt = k ? NBTLittleEndian : 0;
+        NSMutableData *data = [NBTKit dataWithNBT:root name:@"" options:opt error:NULL].mutableCopy;
+        NSMutableDictionary *read = [NBTKit NBTWithData:data name:NULL options:opt error:NULL];
+        memset(data.mutableBytes, 0, data.length);
+        XCTAssertEqualObjects(read, root, @"not affected by changes to the data");
+        XCTAssertEqual([read[@"i"] valueAtIndex:2], 0x12345678);
+        XCTAssertEqual([read[@"l"] valueAtIndex:1], 0x123456789ABCDEF0LL);
+        XCTAssertEqualObjects([NBTKit dataWithNBT:read name:@"" options:opt error:NULL], [NBTKit dataWithNBT:root name:@"" options:opt error:NULL], @"write unmodified arrays");
+        XCTAssertEqualObjects([NBTKit dataWithNBT:read name:@"" options:opt ^ NBTLittleEndian error:NULL], [NBTKit dataWithNBT:root name:@"" options:opt ^ NBTLittleEndian error:NULL], @"write in the other byte order");
+        
+        // copy on write
+        NBTIntArray *intArray = read[@"i"], *intCopy = [intArray copy];
+        NBTLongArray *longArray = read[@"l"], *longCopy = [longArray copy];
+        NSMutableData *byteArray = read[@"b"];
+        [intArray setValue:5 atIndex:0];
+        [longArray addValue:7];
+        ((uint8_t*)byteArray.mutableBytes)[0] = 9;
+        XCTAssertEqual(intArray.values[0], 5);
+        XCTAssertEqual(intArray.values[2], 0x12345678);
+        XCTAssertEqual(longArray.count, (NSUInteger)3);
+        XCTAssertEqual(longArray.values[1], 0x123456789ABCDEF0LL);
+        XCTAssertEqualObjects(byteArray, [NSData dataWithBytes:"\x09\x02\x03" length:3]);
+        XCTAssertEqualObjects(intCopy, root[@"i"], @"copies are not modified");
+        XCTAssertEqualObjects(longCopy, root[@"l"], @"copies are not modified");
+    }
 }
 
 - (void)testNBTIntArray
@@ -279,6 +753,305 @@ static uint8_t dataSample[1000] = {
     [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
 }
 
+- (void)testMCRegionConcurrentReads
+{
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:[self pathForResource:@"r.0.0.mca"]];
+    NSMutableArray *serial = [NSMutableArray arrayWithCapacity:1024];
+    for (int i=0; i < 1024; i++) {
+        [serial addObject:[mcr getChunkAtX:i % 32 Z:i / 32] ?: [NSNull null]];
+    }
+    
+    __block BOOL chunksAllEqual = YES;
+    dispatch_apply(1024, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        id chunk = [mcr getChunkAtX:i % 32 Z:i / 32] ?: [NSNull null];
+        if (![chunk isEqual:serial[i]]) chunksAllEqual = NO;
+    });
+    XCTAssert(chunksAllEqual, @"MCR chunks (concurrent reads)");
+}
+
+- (void)testMCRegionEnumerate
+{
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:[self pathForResource:@"r.0.0.mca"]];
+    
+    // in order
+    __block NSInteger lastIndex = -1;
+    __block BOOL chunksAllEqual = YES;
+    __block NSUInteger count = 0;
+    [mcr enumerateChunksWithOptions:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        if (x + z*32 <= lastIndex) chunksAllEqual = NO;
+        lastIndex = x + z*32;
+        if (![root isEqual:[mcr getChunkAtX:x Z:z]]) chunksAllEqual = NO;
+        count++;
+    }];
+    XCTAssert(chunksAllEqual, @"MCR chunks (ordered enumeration)");
+    XCTAssertGreaterThan(count, 0);
+    
+    // concurrent
+    NSMutableIndexSet *seen = [NSMutableIndexSet indexSet];
+    [mcr enumerateChunksWithOptions:MCRegionEnumerationConcurrent usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        @synchronized(seen) {
+            [seen addIndex:x + z*32];
+        }
+    }];
+    XCTAssertEqual(seen.count, count, @"MCR chunks (concurrent enumeration)");
+    
+    // some chunks, stopping early
+    __block NSUInteger calls = 0;
+    [mcr enumerateChunksAtIndexes:seen options:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        if (++calls == 2) *stop = YES;
+    }];
+    XCTAssertEqual(calls, MIN(count, 2));
+}
+
+- (void)testMCRegionSetChunks
+{
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:[self pathForResource:@"r.0.0.mca"]];
+    char tmp[] = "/tmp/test.mca.XXXXXX";
+    mktemp(tmp);
+    NSString *tmpPath = [NSString stringWithUTF8String:tmp];
+    MCRegion *mcr2 = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    
+    // write all chunks in one batch
+    NSMutableDictionary *chunks = [NSMutableDictionary dictionaryWithCapacity:1024];
+    [mcr enumerateChunksWithOptions:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        chunks[@(x + z*32)] = root;
+    }];
+    XCTAssert([mcr2 setChunks:chunks options:MCRegionWriteSynchronize]);
+    XCTAssertFalse([mcr2 setChunks:@{@1024: bigTest} options:0], @"invalid index");
+    XCTAssertFalse([mcr2 setChunks:@{@0: bigTest, @0.5: bigTest} options:0], @"non-integral index");
+    XCTAssertFalse([mcr2 setChunks:@{@1023: @{@"list": @[NBTInt(1), @"a"]}} options:0], @"invalid chunk");
+    
+    // replace and remove some
+    NSNumber *first = [chunks.allKeys sortedArrayUsingSelector:@selector(compare:)].firstObject;
+    XCTAssert([mcr2 setChunks:@{first: [NSNull null], @1023: bigTest} options:0]);
+    chunks[first] = nil;
+    chunks[@1023] = bigTest;
+    
+    // check chunks after reopening
+    MCRegion *mcr3 = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    BOOL chunksAllEqual = YES;
+    for (int i=0; i < 1024; i++) {
+        NSDictionary *chunk = [mcr3 getChunkAtX:i % 32 Z:i / 32];
+        if (chunk != chunks[@(i)] && ![chunk isEqual:chunks[@(i)]]) chunksAllEqual = NO;
+    }
+    XCTAssert(chunksAllEqual, @"MCR chunks (batch write)");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
+- (void)testMCRegionSectorReuse
+{
+    char tmp[] = "/tmp/test.mca.XXXXXX";
+    mktemp(tmp);
+    NSString *tmpPath = [NSString stringWithUTF8String:tmp];
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+
+    // three chunks of one sector each
+    for (int x=0; x < 3; x++) XCTAssert([mcr setChunk:bigTest atX:x Z:0]);
+    unsigned long long size = [[NSFileManager defaultManager] attributesOfItemAtPath:tmpPath error:NULL].fileSize;
+    XCTAssertEqual(size, 5 * 4096, @"header and three chunks");
+
+    // removing and writing again reuses the free sector
+    XCTAssert([mcr setChunk:nil atX:1 Z:0]);
+    XCTAssertNil([mcr getChunkAtX:1 Z:0]);
+    XCTAssert([mcr setChunk:bigTest atX:5 Z:5]);
+    XCTAssert([mcr setChunk:bigTest atX:0 Z:0]);
+    size = [[NSFileManager defaultManager] attributesOfItemAtPath:tmpPath error:NULL].fileSize;
+    XCTAssertEqual(size, 5 * 4096, @"free sectors reused");
+
+    // header entries are written back
+    MCRegion *mcr2 = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    XCTAssertEqualObjects([mcr2 getChunkAtX:0 Z:0], bigTest);
+    XCTAssertNil([mcr2 getChunkAtX:1 Z:0]);
+    XCTAssertEqualObjects([mcr2 getChunkAtX:2 Z:0], bigTest);
+    XCTAssertEqualObjects([mcr2 getChunkAtX:5 Z:5], bigTest);
+
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
+- (void)testMCRegionUnchangedChunks
+{
+    char tmp[] = "/tmp/test.mca.XXXXXX";
+    mktemp(tmp);
+    NSString *tmpPath = [NSString stringWithUTF8String:tmp];
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    XCTAssert([mcr setChunk:bigTest atX:0 Z:0]);
+    NSData *written = [NSData dataWithContentsOfFile:tmpPath];
+    
+    // same contents aren't compressed or written again
+    [NBTStatistics reset];
+    NBTStatistics.enabled = YES;
+    XCTAssert([mcr setChunk:bigTest atX:0 Z:0]);
+    XCTAssert([mcr setChunks:@{@0: bigTest} options:0]);
+    NBTStatistics *stats = [NBTStatistics snapshot];
+    XCTAssertEqual(stats.compressedBytesWritten, 0, @"unchanged chunk not compressed");
+    XCTAssertEqual(stats.regionSectorsAllocated, 0, @"unchanged chunk not written");
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:tmpPath], written);
+    
+    // chunks read from the file are known too
+    MCRegion *mcr2 = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    NSMutableDictionary *chunk = [mcr2 getChunkAtX:0 Z:0];
+    XCTAssert([mcr2 setChunk:chunk atX:0 Z:0 options:MCRegionWriteTouchUnchanged]);
+    XCTAssertEqual([NBTStatistics snapshot].regionSectorsAllocated, 0, @"unchanged chunk read from file");
+    
+    // changed chunks are written
+    chunk[@"changed"] = NBTByte(1);
+    XCTAssert([mcr2 setChunk:chunk atX:0 Z:0]);
+    XCTAssertEqual([NBTStatistics snapshot].regionSectorsAllocated, 1);
+    XCTAssert([mcr2 setChunk:nil atX:0 Z:0]);
+    XCTAssert([mcr2 setChunk:chunk atX:0 Z:0]);
+    XCTAssertEqual([NBTStatistics snapshot].regionSectorsAllocated, 2, @"removed chunk written again");
+    NBTStatistics.enabled = NO;
+    XCTAssertEqualObjects([[[MCRegion alloc] initWithFileAtPath:tmpPath] getChunkAtX:0 Z:0], chunk);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
+- (void)testMCChunkCache
+{
+    char tmp[] = "/tmp/test.mca.XXXXXX";
+    mktemp(tmp);
+    NSString *tmpPath = [NSString stringWithUTF8String:tmp];
+    MCRegion *mcr = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    XCTAssert([mcr setChunk:bigTest atX:0 Z:0]);
+    XCTAssert([mcr setChunk:bigTest atX:1 Z:0]);
+    MCChunkCache *cache = [[MCChunkCache alloc] initWithByteLimit:1024*1024];
+    mcr.chunkCache = cache;
+    
+    // hits return new trees
+    NSMutableDictionary *chunk = [mcr getChunkAtX:0 Z:0];
+    NSMutableDictionary *chunk2 = [mcr getChunkAtX:0 Z:0];
+    XCTAssertEqual(cache.misses, 1);
+    XCTAssertEqual(cache.hits, 1);
+    XCTAssertEqual(cache.count, 1);
+    XCTAssertNotEqual(chunk, chunk2);
+    chunk[@"changed"] = NBTByte(1);
+    [chunk2[@"listTest (long)"] removeLastObject];
+    [chunk2[@"nested compound test"] removeAllObjects];
+    for (NSString *key in chunk2) {
+        if ([key hasPrefix:@"byteArrayTest"]) ((uint8_t*)[chunk2[key] mutableBytes])[0] = 1;
+    }
+    XCTAssertEqualObjects([mcr getChunkAtX:0 Z:0], bigTest, @"cached chunk not modified");
+    
+    // writing removes the chunk
+    XCTAssert([mcr setChunk:chunk atX:0 Z:0]);
+    XCTAssertEqual(cache.count, 0);
+    XCTAssertEqualObjects([mcr getChunkAtX:0 Z:0], chunk);
+    XCTAssertEqual(cache.misses, 2);
+    
+    // least recently used chunks are evicted
+    cache.byteLimit = cache.byteCount;
+    XCTAssertNotNil([mcr getChunkAtX:1 Z:0]);
+    XCTAssertEqual(cache.count, 1);
+    XCTAssertEqualObjects([mcr getChunkAtX:1 Z:0], bigTest);
+    XCTAssertEqual(cache.hits, 3);
+    
+    [mcr rewrite];
+    XCTAssertEqual(cache.count, 0, @"rewrite removes chunks");
+    XCTAssertEqual(cache.byteCount, 0);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
+- (void)testMCWorld
+{
+    char tmp[] = "/tmp/test.region.XXXXXX";
+    NSString *tmpPath = [NSString stringWithUTF8String:mkdtemp(tmp)];
+    MCWorld *world = [MCWorld worldWithRegionDirectory:tmpPath];
+    XCTAssertEqual(world.regionCount, 0);
+    XCTAssertNil([MCWorld worldWithRegionDirectory:[tmpPath stringByAppendingPathComponent:@"missing"]]);
+    
+    // regions are created as needed
+    world.maxOpenRegions = 1;
+    XCTAssert([world setChunk:bigTest atX:-1 Z:-1 options:0]);
+    XCTAssert([world setChunk:bigTest atX:33 Z:5 options:0]);
+    XCTAssert([world setChunk:bigTest atX:0 Z:0 options:0]);
+    XCTAssert([world setChunk:nil atX:-100 Z:-100 options:0], @"removing from missing region");
+    XCTAssertEqual(world.regionCount, 3);
+    XCTAssert([[NSFileManager defaultManager] fileExistsAtPath:[tmpPath stringByAppendingPathComponent:@"r.-1.-1.mca"]]);
+    XCTAssert([[NSFileManager defaultManager] fileExistsAtPath:[tmpPath stringByAppendingPathComponent:@"r.1.0.mca"]]);
+    
+    // chunks in world coordinates
+    MCWorld *world2 = [MCWorld worldWithRegionDirectory:tmpPath];
+    XCTAssertEqual(world2.regionCount, 3);
+    XCTAssertEqualObjects([world2 getChunkAtX:-1 Z:-1], bigTest);
+    XCTAssertEqualObjects([world2 getChunkAtX:33 Z:5], bigTest);
+    XCTAssertNil([world2 getChunkAtX:31 Z:31]);
+    XCTAssertNil([world2 getChunkAtX:1000 Z:1000]);
+    
+    NSMutableSet *seen = [NSMutableSet set];
+    [world2 enumerateChunksWithOptions:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        [seen addObject:[NSString stringWithFormat:@"%ld,%ld", (long)x, (long)z]];
+    }];
+    XCTAssertEqualObjects(seen, ([NSSet setWithObjects:@"-1,-1", @"33,5", @"0,0", nil]));
+    
+    NSMutableSet *box = [NSMutableSet set];
+    [world2 enumerateChunksFromX:0 Z:0 toX:40 Z:10 options:MCRegionEnumerationConcurrent usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        @synchronized (box) {
+            [box addObject:[NSString stringWithFormat:@"%ld,%ld", (long)x, (long)z]];
+        }
+    }];
+    XCTAssertEqualObjects(box, ([NSSet setWithObjects:@"33,5", @"0,0", nil]));
+    
+    // reading doesn't recreate deleted region files
+    NSString *deletedPath = [tmpPath stringByAppendingPathComponent:@"r.1.0.mca"];
+    XCTAssert([[NSFileManager defaultManager] removeItemAtPath:deletedPath error:NULL]);
+    XCTAssertNil([world getChunkAtX:33 Z:5]);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:deletedPath]);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
+- (void)testMCRegionCompression
+{
+    char tmp[] = "/tmp/test.region.XXXXXX";
+    NSString *tmpPath = [NSString stringWithUTF8String:mkdtemp(tmp)];
+    NSString *regionPath = [tmpPath stringByAppendingPathComponent:@"r.1.2.mca"];
+    MCRegion *mcr = [MCRegion mcrWithFileAtPath:regionPath];
+    XCTAssertEqual(mcr.compression, MCRegionCompressionZlib);
+    
+    // each chunk keeps the compression it was written with
+    MCRegionCompression compressions[] = {MCRegionCompressionGzip, MCRegionCompressionZlib, MCRegionCompressionNone, MCRegionCompressionLZ4};
+    for (int i=0; i < 4; i++) {
+        mcr.compression = compressions[i];
+        XCTAssert([mcr setChunk:bigTest atX:i Z:0]);
+    }
+    MCRegion *mcr2 = [MCRegion mcrWithFileAtPath:regionPath];
+    for (int i=0; i < 4; i++) {
+        XCTAssertEqualObjects([mcr2 getChunkAtX:i Z:0], bigTest, @"compression %d", (int)compressions[i]);
+    }
+    
+    // chunks over 1MB go in their own file
+    NSMutableData *noise = [NSMutableData dataWithLength:1200*1024];
+    arc4random_buf(noise.mutableBytes, noise.length);
+    NSDictionary *bigChunk = @{@"noise": noise};
+    NSString *externalPath = [tmpPath stringByAppendingPathComponent:@"c.37.66.mcc"];
+    mcr.compression = MCRegionCompressionLZ4;
+    XCTAssert([mcr setChunk:bigChunk atX:5 Z:2]);
+    XCTAssert([[NSFileManager defaultManager] fileExistsAtPath:externalPath]);
+    XCTAssertEqualObjects([[MCRegion mcrWithFileAtPath:regionPath] getChunkAtX:5 Z:2], bigChunk);
+    XCTAssert([mcr setChunks:@{@(5 + 2*32): bigTest, @(6 + 2*32): bigChunk} options:0]);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:externalPath], @"replaced external chunk");
+    XCTAssertEqualObjects([[MCRegion mcrWithFileAtPath:regionPath] getChunkAtX:6 Z:2], bigChunk);
+    XCTAssert([mcr setChunk:nil atX:6 Z:2]);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[tmpPath stringByAppendingPathComponent:@"c.38.66.mcc"]], @"removed external chunk");
+    MCRegion *unnamed = [MCRegion mcrWithFileAtPath:[tmpPath stringByAppendingPathComponent:@"region.mca"]];
+    XCTAssertFalse([unnamed setChunk:bigChunk atX:0 Z:0], @"external chunk without region coordinates");
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[tmpPath stringByAppendingPathComponent:@"c.0.0.mcc"]]);
+
+    // unchanged chunks are rewritten when the compression changes
+    mcr.compression = MCRegionCompressionGzip;
+    XCTAssert([mcr setChunk:bigTest atX:7 Z:0]);
+    mcr.compression = MCRegionCompressionLZ4;
+    XCTAssert([mcr setChunk:bigTest atX:7 Z:0]);
+    NSData *regionData = [NSData dataWithContentsOfFile:regionPath];
+    uint32_t location = OSReadBigInt32(regionData.bytes, 4*7);
+    XCTAssertEqual((MCRegionCompression)((const uint8_t*)regionData.bytes)[(location >> 8) * 4096 + 4], MCRegionCompressionLZ4);
+    XCTAssertEqualObjects([[MCRegion mcrWithFileAtPath:regionPath] getChunkAtX:7 Z:0], bigTest);
+
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
+}
+
 - (void)testMCRegionRewrite
 {
     NSString *originalPath = [self pathForResource:@"r.0.0.mca"];
@@ -306,6 +1079,28 @@ static uint8_t dataSample[1000] = {
     }
     XCTAssert(chunksAllEqual, @"MCR chunks (rewrite)");
     
+    // remove every other chunk and compact in place
+    for (int i=0; i < 1024; i += 2) [mcr2 setChunk:nil atX:i % 32 Z:i / 32];
+    unsigned long long size = [[NSFileManager defaultManager] attributesOfItemAtPath:tmpPath error:NULL].fileSize;
+    saved = [mcr2 rewriteInPlace:YES];
+    XCTAssertEqual([[NSFileManager defaultManager] attributesOfItemAtPath:tmpPath error:NULL].fileSize, size - saved);
+    MCRegion *mcr3 = [[MCRegion alloc] initWithFileAtPath:tmpPath];
+    for (int i=0; i < 1024; i++) {
+        NSDictionary *chunk = i % 2 ? [mcr getChunkAtX:i % 32 Z:i / 32] : nil;
+        NSDictionary *chunk3 = [mcr3 getChunkAtX:i % 32 Z:i / 32];
+        if (chunk != chunk3 && ![chunk isEqual:chunk3]) chunksAllEqual = NO;
+    }
+    XCTAssert(chunksAllEqual, @"MCR chunks (rewrite in place)");
+    
+    // rewriting through a symlink replaces its target
+    NSString *linkPath = [tmpPath stringByAppendingString:@".link"];
+    XCTAssertTrue([[NSFileManager defaultManager] createSymbolicLinkAtPath:linkPath withDestinationPath:tmpPath error:NULL]);
+    MCRegion *linked = [[MCRegion alloc] initWithFileAtPath:linkPath];
+    [linked rewrite];
+    XCTAssertEqualObjects([[NSFileManager defaultManager] attributesOfItemAtPath:linkPath error:NULL].fileType, NSFileTypeSymbolicLink);
+    XCTAssertEqualObjects([[[MCRegion alloc] initWithFileAtPath:tmpPath] getChunkAtX:1 Z:0], [mcr getChunkAtX:1 Z:0]);
+    [[NSFileManager defaultManager] removeItemAtPath:linkPath error:NULL];
+    
     // delete temporary file
     [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:NULL];
 }
@@ -0,0 +1,410 @@
+//
+//  main.m
+//  nbtbench
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 namedfork. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <sys/resource.h>
+#import <sys/sysctl.h>
+#import <stdatomic.h>
+#import "NBTKit.h"
+
+// each sample runs a workload for at least this long
+#define NBTBenchMinSampleTime 0.01
+
+void usage(void) {
+    fprintf(stderr, "usage: nbtbench [--iterations=n] [--filter=text] [--baseline=results.jsonl] resources_dir\n");
+    fprintf(stderr, "  resources_dir must contain bigtest.nbt, bigtest_uncompressed.nbt and r.0.0.mca (as in NBTKitTests)\n");
+    exit(EXIT_FAILURE);
+}
+
+#pragma mark - Allocation counting
+
+// counts allocations and heap growth in the default malloc zone while enabled
+static malloc_zone_t *countingZone;
+static void *(*zoneMalloc)(malloc_zone_t *zone, size_t size);
+static void *(*zoneCalloc)(malloc_zone_t *zone, size_t count, size_t size);
+static void *(*zoneRealloc)(malloc_zone_t *zone, void *ptr, size_t size);
+static void (*zoneFree)(malloc_zone_t *zone, void *ptr);
+static void (*zoneFreeDefiniteSize)(malloc_zone_t *zone, void *ptr, size_t size);
+static atomic_bool counting;
+static atomic_uint_fast64_t allocationCount;
+static atomic_int_fast64_t liveBytes, peakBytes;
+
+static void CountAllocation(malloc_zone_t *zone, void *ptr) {
+    if (ptr == NULL || !atomic_load_explicit(&counting, memory_order_relaxed)) return;
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    int64_t size = (int64_t)zone->size(zone, ptr);
+    int64_t live = atomic_fetch_add_explicit(&liveBytes, size, memory_order_relaxed) + size;
+    int64_t peak = atomic_load_explicit(&peakBytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak(&peakBytes, &peak, live));
+}
+
+static void CountFree(malloc_zone_t *zone, void *ptr) {
+    if (ptr == NULL || !atomic_load_explicit(&counting, memory_order_relaxed)) return;
+    atomic_fetch_sub_explicit(&liveBytes, (int64_t)zone->size(zone, ptr), memory_order_relaxed);
+}
+
+static void *CountingMalloc(malloc_zone_t *zone, size_t size) {
+    void *ptr = zoneMalloc(zone, size);
+    CountAllocation(zone, ptr);
+    return ptr;
+}
+
+static void *CountingCalloc(malloc_zone_t *zone, size_t count, size_t size) {
+    void *ptr = zoneCalloc(zone, count, size);
+    CountAllocation(zone, ptr);
+    return ptr;
+}
+
+static void *CountingRealloc(malloc_zone_t *zone, void *ptr, size_t size) {
+    CountFree(zone, ptr);
+    ptr = zoneRealloc(zone, ptr, size);
+    CountAllocation(zone, ptr);
+    return ptr;
+}
+
+static void CountingFree(malloc_zone_t *zone, void *ptr) {
+    CountFree(zone, ptr);
+    zoneFree(zone, ptr);
+}
+
+static void CountingFreeDefiniteSize(malloc_zone_t *zone, void *ptr, size_t size) {
+    CountFree(zone, ptr);
+    zoneFreeDefiniteSize(zone, ptr, size);
+}
+
+void InstallAllocationCounters(void) {
+    countingZone = malloc_default_zone();
+    vm_protect(mach_task_self(), (vm_address_t)countingZone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+    zoneMalloc = countingZone->malloc;
+    zoneCalloc = countingZone->calloc;
+    zoneRealloc = countingZone->realloc;
+    zoneFree = countingZone->free;
+    countingZone->malloc = CountingMalloc;
+    countingZone->calloc = CountingCalloc;
+    countingZone->realloc = CountingRealloc;
+    countingZone->free = CountingFree;
+    if (countingZone->version >= 6 && countingZone->free_definite_size) {
+        zoneFreeDefiniteSize = countingZone->free_definite_size;
+        countingZone->free_definite_size = CountingFreeDefiniteSize;
+    }
+    vm_protect(mach_task_self(), (vm_address_t)countingZone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+}
+
+#pragma mark - Running benchmarks
+
+static NSUInteger iterations = 10;
+static NSString *filter = nil;
+static NSDictionary<NSString*,NSDictionary*> *baseline = nil;
+
+double SecondsFromMachTime(uint64_t t) {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return (double)t * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+void PrintJSON(NSDictionary *object) {
+    NSData *json = [NSJSONSerialization dataWithJSONObject:object options:NSJSONWritingSortedKeys error:NULL];
+    printf("%.*s\n", (int)json.length, (const char*)json.bytes);
+    fflush(stdout);
+}
+
+/**
+ * Runs a workload and prints a line of JSON with its results.
+ *
+ * The workload is warmed up and repeated enough times for each sample to last at least NBTBenchMinSampleTime,
+ * except when it has a setup block, which runs untimed before every repetition.
+ *
+ * @param name Unique name of the workload, used to match results against a baseline.
+ * @param bytes Size of the uncompressed NBT processed by one run of the workload.
+ * @param tags Number of tags processed by one run of the workload.
+ * @param setup Block run before each repetition without being measured, or nil.
+ * @param block Workload to measure.
+ */
+void Bench(NSString *name, NSUInteger bytes, NSUInteger tags, void (^setup)(void), void (^block)(void)) {
+    if (filter && ![name containsString:filter]) return;
+
+    // warm up and calibrate
+    NSUInteger reps = 1;
+    for (;;) {
+        uint64_t elapsed = 0;
+        for (NSUInteger r=0; r < reps; r++) @autoreleasepool {
+            if (setup) setup();
+            uint64_t start = mach_absolute_time();
+            block();
+            elapsed += mach_absolute_time() - start;
+        }
+        if (setup || SecondsFromMachTime(elapsed) >= NBTBenchMinSampleTime) break;
+        reps *= 2;
+    }
+
+    // measure
+    double samples[iterations];
+    atomic_store(&allocationCount, 0);
+    atomic_store(&liveBytes, 0);
+    atomic_store(&peakBytes, 0);
+    for (NSUInteger i=0; i < iterations; i++) {
+        uint64_t elapsed = 0;
+        for (NSUInteger r=0; r < reps; r++) @autoreleasepool {
+            if (setup) setup();
+            atomic_store(&counting, true);
+            uint64_t start = mach_absolute_time();
+            block();
+            elapsed += mach_absolute_time() - start;
+            atomic_store(&counting, false);
+        }
+        samples[i] = SecondsFromMachTime(elapsed) / reps;
+    }
+    qsort_b(samples, iterations, sizeof(double), ^int(const void *a, const void *b) {
+        double da = *(const double*)a, db = *(const double*)b;
+        return (da > db) - (da < db);
+    });
+    double median = iterations % 2 ? samples[iterations / 2] : (samples[iterations / 2 - 1] + samples[iterations / 2]) / 2;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    NSMutableDictionary *result = @{
+        @"name": name,
+        @"iterations": @(iterations),
+        @"repetitions": @(reps),
+        @"bytes": @(bytes),
+        @"tags": @(tags),
+        @"seconds_min": @(samples[0]),
+        @"seconds_median": @(median),
+        @"mb_per_s": @(bytes / median / 1e6),
+        @"tags_per_s": @(tags / median),
+        @"allocations": @(atomic_load(&allocationCount) / (iterations * reps)),
+        @"peak_heap_bytes": @(atomic_load(&peakBytes)),
+        @"max_rss_bytes": @(usage.ru_maxrss),
+    }.mutableCopy;
+    NSNumber *baselineMedian = baseline[name][@"seconds_median"];
+    if (baselineMedian) {
+        result[@"baseline_seconds_median"] = baselineMedian;
+        result[@"speedup"] = @(baselineMedian.doubleValue / median);
+    }
+    PrintJSON(result);
+}
+
+#pragma mark - Data sets
+
+NSUInteger CountTags(id obj) {
+    NSUInteger tags = 1;
+    if ([obj isKindOfClass:[NSDictionary class]]) {
+        for (id value in [obj objectEnumerator]) tags += CountTags(value);
+    } else if ([obj isKindOfClass:[NSArray class]]) {
+        for (id value in obj) tags += CountTags(value);
+    }
+    return tags;
+}
+
+// deterministic pseudo-random values, so every run uses the same data
+uint64_t NextRandom(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 11;
+}
+
+// chunk-like compound dominated by long arrays (block states and heightmaps)
+NSDictionary *LongArrayChunk(void) {
+    uint64_t state = 1;
+    int64_t values[4096];
+    NSMutableArray *sections = [NSMutableArray arrayWithCapacity:24];
+    for (int y=-4; y < 20; y++) {
+        for (int i=0; i < 4096; i++) values[i] = (int64_t)NextRandom(&state);
+        NSMutableData *light = [NSMutableData dataWithLength:2048];
+        for (int i=0; i < 2048; i++) ((uint8_t*)light.mutableBytes)[i] = (uint8_t)NextRandom(&state);
+        [sections addObject:@{
+            @"Y": NBTByte(y),
+            @"BlockStates": [NBTLongArray longArrayWithValues:values count:4096],
+            @"SkyLight": light,
+            @"BlockLight": light.mutableCopy,
+        }];
+    }
+    NSMutableDictionary *heightmaps = [NSMutableDictionary dictionaryWithCapacity:5];
+    for (NSString *name in @[@"MOTION_BLOCKING", @"MOTION_BLOCKING_NO_LEAVES", @"OCEAN_FLOOR", @"WORLD_SURFACE", @"WORLD_SURFACE_WG"]) {
+        for (int i=0; i < 37; i++) values[i] = (int64_t)NextRandom(&state);
+        heightmaps[name] = [NBTLongArray longArrayWithValues:values count:37];
+    }
+    return @{
+        @"DataVersion": NBTInt(2730),
+        @"Level": @{
+            @"xPos": NBTInt(0),
+            @"zPos": NBTInt(0),
+            @"LastUpdate": NBTLong(123456789),
+            @"Status": @"full",
+            @"Sections": sections,
+            @"Heightmaps": heightmaps,
+        },
+    };
+}
+
+// compounds nested depth levels deep, each with a few small values
+NSDictionary *NestedCompounds(NSUInteger depth) {
+    NSDictionary *compound = @{};
+    for (NSUInteger i=depth; i > 0; i--) {
+        compound = @{
+            @"depth": NBTInt((int32_t)i),
+            @"name": [NSString stringWithFormat:@"level %lu", (unsigned long)i],
+            @"values": @[NBTShort(1), NBTShort(2), NBTShort(3)],
+            @"next": compound,
+        };
+    }
+    return compound;
+}
+
+#pragma mark - Workloads
+
+// read and write a tree with every combination of byte order and compression
+void BenchTree(NSString *name, NSDictionary *root, NSDictionary<NSString*,NSData*> *files) {
+    NSDictionary<NSString*,NSNumber*> *variants = @{
+        @"be": @(0),
+        @"le": @(NBTLittleEndian),
+        @"gzip": @(NBTCompressed),
+        @"zlib": @(NBTCompressed | NBTUseZlib),
+        @"le_gzip": @(NBTLittleEndian | NBTCompressed),
+    };
+    NSUInteger bytes = [NBTKit dataWithNBT:root name:name options:0 error:NULL].length;
+    NSUInteger tags = CountTags(root);
+    for (NSString *variant in [variants.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NBTOptions opt = variants[variant].unsignedIntegerValue;
+        NSData *data = files[variant] ?: [NBTKit dataWithNBT:root name:name options:opt error:NULL];
+        Bench([NSString stringWithFormat:@"read.%@.%@", name, variant], bytes, tags, nil, ^{
+            [NBTKit NBTWithData:data name:NULL options:opt error:NULL];
+        });
+        Bench([NSString stringWithFormat:@"write.%@.%@", name, variant], bytes, tags, nil, ^{
+            [NBTKit dataWithNBT:root name:name options:opt error:NULL];
+        });
+    }
+}
+
+void BenchRegion(NSString *path) {
+    MCRegion *region = [MCRegion mcrWithFileAtPath:path];
+    NSMutableDictionary<NSNumber*,NSDictionary*> *chunks = [NSMutableDictionary dictionaryWithCapacity:1024];
+    __block NSUInteger bytes = 0, tags = 0;
+    [region enumerateChunksWithOptions:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {
+        chunks[@(x + z*32)] = root;
+        bytes += [NBTKit dataWithNBT:root name:nil options:0 error:NULL].length;
+        tags += CountTags(root);
+    }];
+    if (chunks.count == 0) return;
+
+    NSNumber *first = [chunks.allKeys sortedArrayUsingSelector:@selector(compare:)].firstObject;
+    NSDictionary *firstChunk = chunks[first];
+    NSUInteger chunkBytes = [NBTKit dataWithNBT:firstChunk name:nil options:0 error:NULL].length;
+    Bench(@"region.read_chunk", chunkBytes, CountTags(firstChunk), nil, ^{
+        [region getChunkAtX:first.integerValue % 32 Z:first.integerValue / 32];
+    });
+    Bench(@"region.scan", bytes, tags, nil, ^{
+        [region enumerateChunksWithOptions:0 usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {}];
+    });
+    Bench(@"region.scan_concurrent", bytes, tags, nil, ^{
+        [region enumerateChunksWithOptions:MCRegionEnumerationConcurrent usingBlock:^(NSMutableDictionary *root, NSInteger x, NSInteger z, NSDate *timestamp, BOOL *stop) {}];
+    });
+
+    // writing workloads use a scratch copy
+    NSString *tmpPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"nbtbench.%d.mca", getpid()]];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    Bench(@"region.set_chunk", chunkBytes, CountTags(firstChunk), ^{
+        [fm removeItemAtPath:tmpPath error:NULL];
+    }, ^{
+        [[MCRegion mcrWithFileAtPath:tmpPath] setChunk:firstChunk atX:first.integerValue % 32 Z:first.integerValue / 32];
+    });
+    Bench(@"region.set_chunks", bytes, tags, ^{
+        [fm removeItemAtPath:tmpPath error:NULL];
+    }, ^{
+        [[MCRegion mcrWithFileAtPath:tmpPath] setChunks:chunks options:0];
+    });
+
+    // rewrite a region that has every other chunk removed
+    void (^fragmentedCopy)(void) = ^{
+        [fm removeItemAtPath:tmpPath error:NULL];
+        [fm copyItemAtPath:path toPath:tmpPath error:NULL];
+        MCRegion *copy = [MCRegion mcrWithFileAtPath:tmpPath];
+        NSMutableDictionary *removed = [NSMutableDictionary dictionaryWithCapacity:512];
+        for (NSNumber *num in chunks) if (num.integerValue % 2) removed[num] = [NSNull null];
+        [copy setChunks:removed options:0];
+    };
+    Bench(@"region.rewrite", bytes / 2, tags / 2, fragmentedCopy, ^{
+        [[MCRegion mcrWithFileAtPath:tmpPath] rewrite];
+    });
+    Bench(@"region.rewrite_in_place", bytes / 2, tags / 2, fragmentedCopy, ^{
+        [[MCRegion mcrWithFileAtPath:tmpPath] rewriteInPlace:YES];
+    });
+    [fm removeItemAtPath:tmpPath error:NULL];
+}
+
+#pragma mark -
+
+NSDictionary<NSString*,NSDictionary*> *LoadBaseline(NSString *path) {
+    NSString *text = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:NULL];
+    if (text == nil) {
+        fprintf(stderr, "Can't read baseline %s\n", path.UTF8String);
+        exit(EXIT_FAILURE);
+    }
+    NSMutableDictionary *results = [NSMutableDictionary dictionary];
+    for (NSString *line in [text componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        NSDictionary *result = [NSJSONSerialization JSONObjectWithData:[line dataUsingEncoding:NSUTF8StringEncoding] options:0 error:NULL];
+        if ([result isKindOfClass:[NSDictionary class]] && result[@"name"]) results[result[@"name"]] = result;
+    }
+    return results;
+}
+
+NSString *HardwareModel(void) {
+    char model[256] = "";
+    size_t size = sizeof model;
+    sysctlbyname("hw.model", model, &size, NULL, 0);
+    return @(model);
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+        NSMutableArray<NSString*> *args = [NSMutableArray arrayWithCapacity:4];
+        for (NSString *arg in [NSProcessInfo.processInfo.arguments subarrayWithRange:NSMakeRange(1, argc - 1)]) {
+            if ([arg hasPrefix:@"--iterations="]) {
+                iterations = MAX([arg substringFromIndex:13].integerValue, 1);
+            } else if ([arg hasPrefix:@"--filter="]) {
+                filter = [arg substringFromIndex:9];
+            } else if ([arg hasPrefix:@"--baseline="]) {
+                baseline = LoadBaseline([arg substringFromIndex:11]);
+            } else if ([arg hasPrefix:@"-"]) {
+                fprintf(stderr, "Unknown flag: %s\n", arg.UTF8String);
+                usage();
+            } else {
+                [args addObject:arg];
+            }
+        }
+        if (args.count != 1) {
+            usage();
+        }
+        NSString *dir = args.firstObject;
+        NSData *bigtest = [NSData dataWithContentsOfFile:[dir stringByAppendingPathComponent:@"bigtest.nbt"]];
+        NSData *bigtestUncompressed = [NSData dataWithContentsOfFile:[dir stringByAppendingPathComponent:@"bigtest_uncompressed.nbt"]];
+        NSString *regionPath = [dir stringByAppendingPathComponent:@"r.0.0.mca"];
+        if (bigtest == nil || bigtestUncompressed == nil || ![[NSFileManager defaultManager] fileExistsAtPath:regionPath]) {
+            usage();
+        }
+
+        PrintJSON(@{
+            @"nbtbench": @1,
+            @"date": [[NSISO8601DateFormatter new] stringFromDate:[NSDate date]],
+            @"hardware": HardwareModel(),
+            @"os": NSProcessInfo.processInfo.operatingSystemVersionString,
+            @"cpus": @(NSProcessInfo.processInfo.activeProcessorCount),
+            @"iterations": @(iterations),
+        });
+        InstallAllocationCounters();
+
+        NSDictionary *bigtestRoot = [NBTKit NBTWithData:bigtestUncompressed name:NULL options:0 error:NULL];
+        BenchTree(@"bigtest", bigtestRoot, @{@"be": bigtestUncompressed, @"gzip": bigtest});
+        BenchTree(@"long_arrays", LongArrayChunk(), @{});
+        BenchTree(@"nested", NestedCompounds(512), @{});
+        BenchRegion(regionPath);
+    }
+    return 0;
+}
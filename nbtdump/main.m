@@ -8,9 +8,13 @@
 
 #import <Foundation/Foundation.h>
 #import "NBTKit.h"
+#import "NBTKit_Private.h"
+
+#define NBTDumpFlushSize (64*1024)
 
 void usage(void) {
-    fprintf(stderr, "usage: nbtdump [--compressed] [--little_endian] file\n");
+    fprintf(stderr, "usage: nbtdump [--compressed] [--little_endian] [--stats] [--max_depth=n] [--max_array=n] [--chunk=x,z ...] file\n");
+    fprintf(stderr, "  region files (.mca, .mcr) dump the given chunks, or all of them\n");
     exit(EXIT_FAILURE);
 }
 
@@ -39,18 +43,229 @@ BOOL ParseArguments(NSSet<NSString*> ** flags, NSArray<NSString*>** args, BOOL i
     if (args) {
         *args = [NSArray arrayWithArray:parsedArgs];
     }
-    [parsedFlags minusSet:knownFlags];
+    // flags with values are known by the part before =
+    for (NSString *flag in parsedFlags.allObjects) {
+        if ([knownFlags containsObject:[flag componentsSeparatedByString:@"="].firstObject]) [parsedFlags removeObject:flag];
+    }
     return parsedFlags.count == 0;
 }
 
+// Returns the values of a flag given as --name=value, in the order they were given
+NSArray<NSString*> *FlagValues(NSString *name) {
+    NSString *prefix = [name stringByAppendingString:@"="];
+    NSMutableArray<NSString*> *values = [NSMutableArray array];
+    for (NSString *arg in NSProcessInfo.processInfo.arguments) {
+        if ([arg isEqualToString:@"--"]) break;
+        if ([arg hasPrefix:prefix]) [values addObject:[arg substringFromIndex:prefix.length]];
+    }
+    return values;
+}
+
+/// Prints NBT as it's parsed, as indented text with the tag types
+@interface NBTDumper : NSObject <NBTParserDelegate>
+/// Text printed so far, and not yet written to file
+@property (nonatomic, readonly) NSMutableData *output;
+/// Compounds and lists deeper than this are elided
+@property (nonatomic, assign) NSUInteger maxDepth;
+/// Values printed for each array
+@property (nonatomic, assign) NSUInteger maxArray;
+/// Indentation added to every line
+@property (nonatomic, assign) NSUInteger indent;
+/// The output is written to this file as it grows, or kept in output if NULL
+- (instancetype)initWithFile:(FILE *)file;
+- (void)print:(const char *)format, ... __printflike(1, 2);
+- (void)flush;
+@end
+
+@implementation NBTDumper
+{
+    FILE *file;
+    NBTType arrayType;
+    NSUInteger arrayCount, arrayPrinted;
+}
+
+- (instancetype)initWithFile:(FILE *)aFile
+{
+    if ((self = [super init])) {
+        file = aFile;
+        _output = [NSMutableData dataWithCapacity:NBTDumpFlushSize];
+        _maxDepth = NSUIntegerMax;
+        _maxArray = NSUIntegerMax;
+    }
+    return self;
+}
+
+- (void)print:(const char *)format, ...
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(buf, sizeof buf, format, ap);
+    va_end(ap);
+    if (len < 0) return;
+    if (len < sizeof buf) {
+        [_output appendBytes:buf length:len];
+    } else {
+        char *longBuf = NULL;
+        va_start(ap, format);
+        len = vasprintf(&longBuf, format, ap);
+        va_end(ap);
+        if (len > 0) [_output appendBytes:longBuf length:len];
+        free(longBuf);
+    }
+    if (file && _output.length >= NBTDumpFlushSize) [self flush];
+}
+
+- (void)flush
+{
+    if (file == NULL) return;
+    fwrite(_output.bytes, 1, _output.length, file);
+    _output.length = 0;
+}
+
+- (void)printString:(NSString *)string
+{
+    [self print:"\""];
+    const char *s = string.UTF8String;
+    for (const char *run = s; *s; run = s) {
+        while (*s && *s != '"' && *s != '\\' && *s != '\n') s++;
+        if (s > run) [_output appendBytes:run length:s - run];
+        if (*s == 0) break;
+        [self print:"%s", *s == '\n' ? "\\n" : *s == '"' ? "\\\"" : "\\\\"];
+        s++;
+    }
+    [self print:"\""];
+}
+
+// prints the indentation and tag type, with the name if it isn't in a list
+- (void)printTag:(NBTType)type name:(NSString *)name depth:(NSUInteger)depth
+{
+    [self print:"%*s%s", (int)(2 * (_indent + depth)), "", [NBTKit nameOfNBTType:type].UTF8String];
+    if (name) {
+        [self print:"("];
+        [self printString:name];
+        [self print:")"];
+    }
+    [self print:": "];
+}
+
+- (void)parser:(NBTParser *)parser didStartCompoundWithName:(NSString *)name
+{
+    if (parser.depth > _maxDepth) return;
+    [self printTag:NBTTypeCompound name:name depth:parser.depth];
+    [self print:"%s", parser.depth == _maxDepth ? "{...}\n" : "{\n"];
+}
+
+- (void)parserDidEndCompound:(NBTParser *)parser
+{
+    if (parser.depth >= _maxDepth) return;
+    [self print:"%*s}\n", (int)(2 * (_indent + parser.depth)), ""];
+}
+
+- (void)parser:(NBTParser *)parser didStartListWithName:(NSString *)name type:(NBTType)type count:(NSUInteger)count
+{
+    if (parser.depth > _maxDepth) return;
+    [self printTag:NBTTypeList name:name depth:parser.depth];
+    [self print:"%lu %s %s\n", (unsigned long)count, [NBTKit nameOfNBTType:type].UTF8String ?: "TAG_Unknown", parser.depth == _maxDepth ? "[...]" : "["];
+}
+
+- (void)parserDidEndList:(NBTParser *)parser
+{
+    if (parser.depth >= _maxDepth) return;
+    [self print:"%*s]\n", (int)(2 * (_indent + parser.depth)), ""];
+}
+
+- (void)parser:(NBTParser *)parser foundInteger:(int64_t)value type:(NBTType)type name:(NSString *)name
+{
+    if (parser.depth > _maxDepth) return;
+    [self printTag:type name:name depth:parser.depth];
+    [self print:"%lld\n", (long long)value];
+}
+
+- (void)parser:(NBTParser *)parser foundFloat:(double)value type:(NBTType)type name:(NSString *)name
+{
+    if (parser.depth > _maxDepth) return;
+    [self printTag:type name:name depth:parser.depth];
+    [self print:type == NBTTypeFloat ? "%.9g\n" : "%.17g\n", value];
+}
+
+- (void)parser:(NBTParser *)parser foundString:(NSString *)string name:(NSString *)name
+{
+    if (parser.depth > _maxDepth) return;
+    [self printTag:NBTTypeString name:name depth:parser.depth];
+    [self printString:string];
+    [self print:"\n"];
+}
+
+- (void)parser:(NBTParser *)parser didStartArrayWithName:(NSString *)name type:(NBTType)type count:(NSUInteger)count
+{
+    arrayType = type;
+    arrayCount = count;
+    arrayPrinted = 0;
+    if (parser.depth > _maxDepth) return;
+    [self printTag:type name:name depth:parser.depth];
+    [self print:"%lu [", (unsigned long)count];
+}
+
+- (void)parser:(NBTParser *)parser foundArrayValues:(const void *)values count:(NSUInteger)count
+{
+    if (parser.depth > _maxDepth) return;
+    for (NSUInteger i=0; i < count && arrayPrinted < _maxArray; i++, arrayPrinted++) {
+        long long value = arrayType == NBTTypeByteArray ? ((const int8_t*)values)[i] : arrayType == NBTTypeIntArray ? ((const int32_t*)values)[i] : ((const int64_t*)values)[i];
+        [self print:arrayPrinted ? ", %lld" : "%lld", value];
+    }
+}
+
+- (void)parserDidEndArray:(NBTParser *)parser
+{
+    if (parser.depth > _maxDepth) return;
+    if (arrayPrinted < arrayCount) [self print:arrayPrinted ? ", ... %lu more" : "... %lu", (unsigned long)(arrayCount - arrayPrinted)];
+    [self print:"]\n"];
+}
+
+@end
+
+// Dumps the chunks of a region in order, decoding them in parallel, returns NO if any of them couldn't be read
+BOOL DumpRegion(MCRegion *region, NSArray<NSNumber*> *chunks, NBTDumper *(^makeDumper)(FILE *file)) {
+    __block BOOL ok = YES;
+    NSUInteger batchSize = 2 * NSProcessInfo.processInfo.activeProcessorCount;
+    for (NSUInteger start = 0; start < chunks.count; start += batchSize) {
+        NSArray<NSNumber*> *batch = [chunks subarrayWithRange:NSMakeRange(start, MIN(batchSize, chunks.count - start))];
+        NSMutableArray *outputs = [NSMutableArray arrayWithCapacity:batch.count];
+        for (NSUInteger i=0; i < batch.count; i++) [outputs addObject:[NSNull null]];
+        dispatch_apply(batch.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            @autoreleasepool {
+                NSUInteger num = batch[i].unsignedIntegerValue;
+                NSData *data = [region _readChunkData:num];
+                if (data == nil) return;
+                NBTDumper *dumper = makeDumper(NULL);
+                [dumper print:"Chunk [%lu, %lu] %s\n", (unsigned long)(num % 32), (unsigned long)(num / 32), [region _chunkTimestamp:num].description.UTF8String];
+                dumper.indent = 1;
+                NBTParser *parser = [[NBTParser alloc] initWithData:data options:NBTInternStrings];
+                parser.delegate = dumper;
+                BOOL parsed = [parser parse];
+                if (!parsed) [dumper print:"  error: %s\n", parser.parserError.description.UTF8String];
+                @synchronized (outputs) {
+                    outputs[i] = dumper.output;
+                    if (!parsed) ok = NO;
+                }
+            }
+        });
+        for (NSData *output in outputs) {
+            if ([output isKindOfClass:[NSData class]]) fwrite(output.bytes, 1, output.length, stdout);
+        }
+    }
+    return ok;
+}
+
 int main(int argc, const char * argv[]) {
     @autoreleasepool {
         NSSet<NSString*> *flags = nil;
         NSArray<NSString*> *args = nil;
-        NSSet<NSString*> *knownFlags = [NSSet setWithObjects:@"--little_endian", @"--compressed", nil];
+        NSSet<NSString*> *knownFlags = [NSSet setWithObjects:@"--little_endian", @"--compressed", @"--stats", @"--max_depth", @"--max_array", @"--chunk", nil];
         if (!ParseArguments(&flags, &args, NO, knownFlags)) {
             NSArray<NSString*> *unknownFlags = [flags objectsPassingTest:^BOOL(NSString * _Nonnull obj, BOOL * _Nonnull stop) {
-                return ![knownFlags containsObject:obj];
+                return ![knownFlags containsObject:[obj componentsSeparatedByString:@"="].firstObject];
             }].allObjects;
             fprintf(stderr, "Unknown flags: %s\n", [unknownFlags componentsJoinedByString:@", "].UTF8String);
             usage();
@@ -68,18 +283,66 @@ int main(int argc, const char * argv[]) {
             options |= NBTCompressed;
         }
         
-        NSError *error = nil;
-        NSString *rootTag = nil;
-        NSMutableDictionary *nbt = [NBTKit NBTWithFile:path name:&rootTag options:options error:&error];
-        if (error) {
-            fprintf(stderr, "Error reading NBT: %s\n", error.description.UTF8String);
+        if ([flags containsObject:@"--stats"]) {
+            NBTStatistics.enabled = YES;
+        }
+        
+        NSString *maxDepth = FlagValues(@"--max_depth").lastObject;
+        NSString *maxArray = FlagValues(@"--max_array").lastObject;
+        NBTDumper *(^makeDumper)(FILE *file) = ^(FILE *file) {
+            NBTDumper *dumper = [[NBTDumper alloc] initWithFile:file];
+            if (maxDepth) dumper.maxDepth = (NSUInteger)MAX(maxDepth.integerValue, 0);
+            if (maxArray) dumper.maxArray = (NSUInteger)MAX(maxArray.integerValue, 0);
+            return dumper;
+        };
+        
+        if (![NSFileManager.defaultManager fileExistsAtPath:path]) {
+            fprintf(stderr, "%s: No such file\n", path.UTF8String);
+            exit(EXIT_FAILURE);
+        }
+        
+        NSString *extension = path.pathExtension.lowercaseString;
+        if ([extension isEqualToString:@"mca"] || [extension isEqualToString:@"mcr"]) {
+            MCRegion *region = [MCRegion mcrWithFileAtPath:path];
+            if (region == nil) {
+                fprintf(stderr, "Error reading region file\n");
+                exit(EXIT_FAILURE);
+            }
+            // chunk coordinates are taken modulo 32, so world coordinates work too, each chunk is dumped once in the order given
+            NSMutableOrderedSet<NSNumber*> *chunks = [NSMutableOrderedSet orderedSet];
+            for (NSString *chunk in FlagValues(@"--chunk")) {
+                NSArray<NSString*> *xz = [chunk componentsSeparatedByString:@","];
+                if (xz.count != 2) usage();
+                [chunks addObject:@((xz[0].integerValue & 31) + (xz[1].integerValue & 31) * 32)];
+            }
+            if (chunks.count == 0) {
+                for (NSUInteger num=0; num < 1024; num++) [chunks addObject:@(num)];
+            }
+            BOOL ok = DumpRegion(region, chunks.array, makeDumper);
+            fflush(stdout);
+            if (NBTStatistics.enabled) {
+                fprintf(stderr, "%s\n", [NBTStatistics snapshot].description.UTF8String);
+            }
+            return ok ? 0 : EXIT_FAILURE;
+        }
+        
+        // print as it's read
+        NSInputStream *stream = [NSInputStream inputStreamWithFileAtPath:path];
+        [stream open];
+        NBTParser *parser = [[NBTParser alloc] initWithStream:stream options:options];
+        NBTDumper *dumper = makeDumper(stdout);
+        parser.delegate = dumper;
+        BOOL ok = [parser parse];
+        [dumper flush];
+        fflush(stdout);
+        if (!ok) {
+            fprintf(stderr, "Error reading NBT: %s\n", parser.parserError.description.UTF8String);
             exit(EXIT_FAILURE);
         }
         
-        if (rootTag.length > 0) {
-            printf("%s:\n", rootTag.UTF8String);
+        if (NBTStatistics.enabled) {
+            fprintf(stderr, "%s\n", [NBTStatistics snapshot].description.UTF8String);
         }
-        printf("%s\n", nbt.description.UTF8String);
     }
     return 0;
 }